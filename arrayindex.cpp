@@ -0,0 +1,510 @@
+#include "arrayindex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// Records per thread below which a rebuild is not split further
+constexpr size_t MinChunkSize = 4096;
+
+// Ranks of the groups compared first by ArrayIndex::compare
+int rank(Value::Type type)
+{
+    switch (type) {
+    case Value::Type::Null:
+        return 0;
+    case Value::Type::Bool:
+        return 1;
+    case Value::Type::Int:
+    case Value::Type::UInt:
+    case Value::Type::Int64:
+    case Value::Type::UInt64:
+    case Value::Type::Double:
+        return 2;
+    case Value::Type::String:
+    case Value::Type::CompactString:
+        return 3;
+    default:
+        return 4 + int(type);
+    }
+}
+
+template<typename T>
+int threeWay(const T &lhs, const T &rhs)
+{
+    return lhs < rhs ? -1 : rhs < lhs ? 1 : 0;
+}
+
+// Order of strings of either type by UTF-16 code units, like QString, without converting a
+// CompactString
+int compareStrings(const Value &lhs, const Value &rhs)
+{
+    const bool lhsCompact = lhs.type() == Value::Type::CompactString;
+    const bool rhsCompact = rhs.type() == Value::Type::CompactString;
+    if (lhsCompact && rhsCompact)
+        return threeWay(lhs.get<CompactString>(), rhs.get<CompactString>());
+    if (lhsCompact)
+        return lhs.get<CompactString>().compare(rhs.get<QString>());
+    if (rhsCompact)
+        return -rhs.get<CompactString>().compare(lhs.get<QString>());
+    return threeWay(lhs.get<QString>(), rhs.get<QString>());
+}
+
+// An integer of any signedness as a sign and its two's complement bits, which keep the order
+// of numbers of the same sign
+struct Integer
+{
+    bool negative;
+    uint64_t bits;
+};
+
+Integer toInteger(const Value &v)
+{
+    switch (v.type()) {
+    case Value::Type::Int: return {v.get<int32_t>() < 0, uint64_t(int64_t(v.get<int32_t>()))};
+    case Value::Type::UInt: return {false, v.get<uint32_t>()};
+    case Value::Type::Int64: return {v.get<int64_t>() < 0, uint64_t(v.get<int64_t>())};
+    default: return {false, v.get<uint64_t>()};
+    }
+}
+
+int compareIntegers(Integer lhs, Integer rhs)
+{
+    if (lhs.negative != rhs.negative)
+        return lhs.negative ? -1 : 1;
+    return threeWay(lhs.bits, rhs.bits);
+}
+
+// Exact, unlike converting the integer to double, which would make 2^53 + 1 equal to 2^53
+int compareIntegerToDouble(Integer lhs, double rhs)
+{
+    // NaN orders after all numbers
+    if (std::isnan(rhs))
+        return -1;
+    // integers are in [-2^63, 2^64)
+    if (rhs >= 0x1p64)
+        return -1;
+    if (rhs < -0x1p63)
+        return 1;
+    const double whole = std::trunc(rhs);
+    const Integer integer = whole < 0 ? Integer{true, uint64_t(int64_t(whole))}
+                                      : Integer{false, uint64_t(whole)};
+    if (const int result = compareIntegers(lhs, integer))
+        return result;
+    return threeWay(0., rhs - whole);
+}
+
+int compareDoubles(double lhs, double rhs)
+{
+    if (std::isnan(lhs) || std::isnan(rhs))
+        return threeWay(std::isnan(lhs), std::isnan(rhs));
+    return threeWay(lhs, rhs);
+}
+
+int compareNumbers(const Value &lhs, const Value &rhs)
+{
+    const bool lhsDouble = lhs.type() == Value::Type::Double;
+    const bool rhsDouble = rhs.type() == Value::Type::Double;
+    if (lhsDouble && rhsDouble)
+        return compareDoubles(lhs.get<double>(), rhs.get<double>());
+    if (lhsDouble)
+        return -compareIntegerToDouble(toInteger(rhs), lhs.get<double>());
+    if (rhsDouble)
+        return compareIntegerToDouble(toInteger(lhs), rhs.get<double>());
+    return compareIntegers(toInteger(lhs), toInteger(rhs));
+}
+
+// Numbers equal by value hash alike: integral doubles hash as the integer, integers as the
+// widest type of their sign
+size_t hashNumber(const Value &v)
+{
+    if (v.type() == Value::Type::Double) {
+        const double d = v.get<double>();
+        if (std::isnan(d))
+            return std::hash<Value>()(std::numeric_limits<double>::quiet_NaN());
+        if (d != std::trunc(d) || d >= 0x1p64 || d < -0x1p63)
+            return std::hash<Value>()(d);
+        return d < 0 ? std::hash<Value>()(int64_t(d)) : std::hash<Value>()(uint64_t(d));
+    }
+    const auto integer = toInteger(v);
+    return integer.negative ? std::hash<Value>()(int64_t(integer.bits))
+                            : std::hash<Value>()(integer.bits);
+}
+
+// Hash matching ArrayIndex::compare() == 0
+size_t hashKey(const Value &v)
+{
+    return rank(v.type()) == 2 ? hashNumber(v) : std::hash<Value>()(v);
+}
+
+// Same as ArrayIndex::compare() == 0, without ordering strings
+bool equalKeys(const Value &lhs, const Value &rhs)
+{
+    const int lhsRank = rank(lhs.type());
+    if (lhsRank != rank(rhs.type()))
+        return false;
+    if (lhsRank == 2)
+        return compareNumbers(lhs, rhs) == 0;
+    if (lhsRank > 3)
+        return ArrayIndex::compare(lhs, rhs) == 0;
+    return lhs == rhs;
+}
+
+template<typename List, typename Compare>
+int compareLists(const List &lhs, const List &rhs, Compare compare)
+{
+    if (lhs.size() != rhs.size())
+        return threeWay(lhs.size(), rhs.size());
+    auto r = rhs.begin();
+    for (auto l = lhs.begin(); l != lhs.end(); ++l, ++r) {
+        if (const int result = compare(*l, *r))
+            return result;
+    }
+    return 0;
+}
+
+// Order of containers of the same type with the same hash, by size and then by content
+int compareContainers(const Value &lhs, const Value &rhs)
+{
+    switch (lhs.type()) {
+    case Value::Type::StringList:
+        return compareLists(lhs.get<QStringList>(), rhs.get<QStringList>(),
+                            threeWay<QString>);
+    case Value::Type::Array:
+        return compareLists(lhs.get<Array>(), rhs.get<Array>(), ArrayIndex::compare);
+    case Value::Type::Object: {
+        // by keys, then by values, both in key order
+        using Item = std::pair<const Object::Key *, const Value *>;
+        const auto sorted = [](const Object &object) {
+            std::vector<Item> result;
+            result.reserve(object.size());
+            for (const auto &item: object)
+                result.emplace_back(&item.first, &item.second);
+            std::sort(result.begin(), result.end(), [](const Item &l, const Item &r) {
+                return *l.first < *r.first;
+            });
+            return result;
+        };
+        const auto l = sorted(lhs.get<Object>());
+        const auto r = sorted(rhs.get<Object>());
+        if (const int result = compareLists(l, r, [](const Item &a, const Item &b) {
+                return threeWay(*a.first, *b.first);
+            })) {
+            return result;
+        }
+        return compareLists(l, r, [](const Item &a, const Item &b) {
+            return ArrayIndex::compare(*a.second, *b.second);
+        });
+    }
+    case Value::Type::DoubleArray:
+        return compareLists(lhs.get<DoubleArray>(), rhs.get<DoubleArray>(), compareDoubles);
+    case Value::Type::Int64Array:
+        return compareLists(lhs.get<Int64Array>(), rhs.get<Int64Array>(), threeWay<int64_t>);
+    default:
+        return 0;
+    }
+}
+
+// Joins the threads when going out of scope, also when an exception is thrown
+struct JoiningThreads
+{
+    std::vector<std::thread> threads;
+
+    ~JoiningThreads()
+    {
+        for (auto &thread: threads) {
+            if (thread.joinable())
+                thread.join();
+        }
+    }
+};
+
+} // namespace
+
+ArrayIndex::ArrayIndex(Kind kind, std::vector<ValuePath> keyPaths)
+    : m_kind(kind)
+    , m_keyPaths(std::move(keyPaths))
+{
+    if (m_keyPaths.empty())
+        throw std::invalid_argument("ArrayIndex: no key paths");
+    // keys are converted once, not on every lookup
+    for (const auto &path: m_keyPaths) {
+        std::vector<Step> steps;
+        for (const auto &step: path.steps())
+            steps.push_back({step.isIndex() ? ObjectKey() : ObjectKey(step.key()), step.index(),
+                             step.isIndex()});
+        m_steps.push_back(std::move(steps));
+    }
+}
+
+ArrayIndex::ArrayIndex(Kind kind, ValuePath keyPath)
+    : ArrayIndex(kind, std::vector<ValuePath>{std::move(keyPath)})
+{
+}
+
+void ArrayIndex::rebuild(const Array &array, unsigned threads)
+{
+    m_array = array;
+    try {
+        const size_t count = m_array.size();
+        m_keys.assign(count * m_keyPaths.size(), nullptr);
+        m_entries.clear();
+        m_buckets.clear();
+
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        const size_t chunks = std::clamp<size_t>(count / MinChunkSize, 1, threads);
+
+        // each chunk extracts the keys of its records and sorts its entries
+        std::vector<std::vector<Entry>> entries(chunks);
+        std::vector<std::exception_ptr> errors(chunks);
+        const auto indexChunkAt = [this, count, chunks, &entries, &errors](size_t chunk) {
+            try {
+                indexChunk(count * chunk / chunks, count * (chunk + 1) / chunks, entries[chunk]);
+            } catch (...) {
+                errors[chunk] = std::current_exception();
+            }
+        };
+        {
+            JoiningThreads workers;
+            for (size_t chunk = 1; chunk < chunks; ++chunk)
+                workers.threads.emplace_back(indexChunkAt, chunk);
+            indexChunkAt(0);
+        }
+        for (const auto &error: errors) {
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+        size_t total = 0;
+        for (const auto &chunk: entries)
+            total += chunk.size();
+        m_entries.reserve(total);
+        const auto less = [this](const Entry &lhs, const Entry &rhs) {
+            return lessEntry(lhs, rhs);
+        };
+        for (const auto &chunk: entries) {
+            const auto middle = std::ptrdiff_t(m_entries.size());
+            m_entries.insert(m_entries.end(), chunk.begin(), chunk.end());
+            std::inplace_merge(m_entries.begin(), m_entries.begin() + middle, m_entries.end(),
+                               less);
+        }
+        if (m_kind == Kind::Hash)
+            buildBuckets();
+    } catch (...) {
+        // an empty index of no array, which isStale() reports
+        m_array = Array();
+        m_keys.clear();
+        m_entries.clear();
+        m_buckets.clear();
+        throw;
+    }
+}
+
+void ArrayIndex::buildBuckets()
+{
+    size_t groups = 0;
+    for (size_t i = 0; i < m_entries.size(); ++i)
+        groups += i == 0 || m_entries[i].hash != m_entries[i - 1].hash;
+    if (groups == 0)
+        return;
+    size_t size = 16;
+    while (size < 2 * groups)
+        size *= 2;
+    m_buckets.assign(size, 0);
+    const size_t mask = size - 1;
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        if (i > 0 && m_entries[i].hash == m_entries[i - 1].hash)
+            continue;
+        size_t bucket = m_entries[i].hash & mask;
+        while (m_buckets[bucket])
+            bucket = (bucket + 1) & mask;
+        m_buckets[bucket] = i + 1;
+    }
+}
+
+std::vector<size_t> ArrayIndex::find(const Value &key) const
+{
+    std::vector<size_t> result;
+    const auto query = queryKeys(key);
+    if (query.empty())
+        return result;
+    const auto [begin, end] = equalRange(query.data());
+    for (size_t i = begin; i < end; ++i) {
+        const auto position = m_entries[i].position;
+        if (m_kind == Kind::Sorted || equalKeys(keysAt(position), query.data()))
+            result.push_back(position);
+    }
+    return result;
+}
+
+const Value *ArrayIndex::findFirst(const Value &key) const
+{
+    const auto query = queryKeys(key);
+    if (query.empty())
+        return nullptr;
+    const auto [begin, end] = equalRange(query.data());
+    for (size_t i = begin; i < end; ++i) {
+        const auto position = m_entries[i].position;
+        if (m_kind == Kind::Sorted || equalKeys(keysAt(position), query.data()))
+            return &m_array.at(position);
+    }
+    return nullptr;
+}
+
+std::vector<size_t> ArrayIndex::range(const Value &lower, const Value &upper) const
+{
+    if (m_kind != Kind::Sorted)
+        throw std::logic_error("ArrayIndex::range: not a sorted index");
+    std::vector<size_t> result;
+    const auto lowerKeys = queryKeys(lower);
+    const auto upperKeys = queryKeys(upper);
+    if (lowerKeys.empty() || upperKeys.empty())
+        return result;
+    const auto begin = equalRange(lowerKeys.data()).first;
+    const auto end = equalRange(upperKeys.data()).first;
+    for (size_t i = begin; i < end; ++i)
+        result.push_back(m_entries[i].position);
+    return result;
+}
+
+int ArrayIndex::compare(const Value &lhs, const Value &rhs)
+{
+    const int lhsRank = rank(lhs.type());
+    const int rhsRank = rank(rhs.type());
+    if (lhsRank != rhsRank)
+        return threeWay(lhsRank, rhsRank);
+    switch (lhsRank) {
+    case 0:
+        return 0;
+    case 1:
+        return threeWay(lhs.get<bool>(), rhs.get<bool>());
+    case 2:
+        return compareNumbers(lhs, rhs);
+    case 3:
+        return compareStrings(lhs, rhs);
+    default:
+        // containers have no natural order, any consistent one will do: by hash, and by
+        // content for the rare ones with the same hash
+        if (lhs.isSharedWith(rhs))
+            return 0;
+        if (const int result = threeWay(std::hash<Value>()(lhs), std::hash<Value>()(rhs)))
+            return result;
+        return compareContainers(lhs, rhs);
+    }
+}
+
+size_t ArrayIndex::hashKeys(const Value *const *keys) const noexcept
+{
+    if (m_keyPaths.size() == 1)
+        return hashKey(*keys[0]);
+    size_t seed = Hashing::seed();
+    for (size_t i = 0; i < m_keyPaths.size(); ++i)
+        seed = Hashing::combine(seed, hashKey(*keys[i]));
+    return Hashing::finalize(seed, m_keyPaths.size());
+}
+
+int ArrayIndex::compareKeys(const Value *const *lhs, const Value *const *rhs) const
+{
+    for (size_t i = 0; i < m_keyPaths.size(); ++i) {
+        if (const int result = compare(*lhs[i], *rhs[i]))
+            return result;
+    }
+    return 0;
+}
+
+bool ArrayIndex::equalKeys(const Value *const *lhs, const Value *const *rhs) const
+{
+    for (size_t i = 0; i < m_keyPaths.size(); ++i) {
+        if (!::equalKeys(*lhs[i], *rhs[i]))
+            return false;
+    }
+    return true;
+}
+
+bool ArrayIndex::lessEntry(const Entry &lhs, const Entry &rhs) const
+{
+    if (m_kind == Kind::Hash) {
+        if (lhs.hash != rhs.hash)
+            return lhs.hash < rhs.hash;
+    } else if (const int result = compareKeys(keysAt(lhs.position), keysAt(rhs.position))) {
+        return result < 0;
+    }
+    return lhs.position < rhs.position;
+}
+
+auto ArrayIndex::queryKeys(const Value &key) const -> Keys
+{
+    if (m_keyPaths.size() == 1)
+        return {&key};
+    Keys result;
+    if (key.type() != Value::Type::Array || key.get<Array>().size() != m_keyPaths.size())
+        return result;
+    for (const auto &component: key.get<Array>())
+        result.push_back(&component);
+    return result;
+}
+
+void ArrayIndex::indexChunk(size_t begin, size_t end, std::vector<Entry> &entries)
+{
+    const size_t paths = m_keyPaths.size();
+    entries.reserve(end - begin);
+    for (size_t position = begin; position < end; ++position) {
+        const auto keys = m_keys.data() + position * paths;
+        bool complete = true;
+        for (size_t i = 0; i < paths; ++i) {
+            const Value *value = &m_array.at(position);
+            for (const auto &step: m_steps[i]) {
+                if (step.isIndex) {
+                    const auto array = value->getIf<Array>();
+                    value = array && step.index < array->size() ? &array->at(step.index) : nullptr;
+                } else {
+                    const auto object = value->getIf<Object>();
+                    const auto it = object ? object->find(step.key) : Object::const_iterator();
+                    value = object && it != object->end() ? &it->second : nullptr;
+                }
+                if (!value)
+                    break;
+            }
+            keys[i] = value;
+            complete = complete && value;
+        }
+        if (complete)
+            entries.push_back({m_kind == Kind::Hash ? hashKeys(keys) : 0, position});
+    }
+    const auto less = [this](const Entry &lhs, const Entry &rhs) { return lessEntry(lhs, rhs); };
+    std::sort(entries.begin(), entries.end(), less);
+}
+
+std::pair<size_t, size_t> ArrayIndex::equalRange(const Value *const *query) const
+{
+    if (m_kind == Kind::Hash) {
+        if (m_buckets.empty())
+            return {0, 0};
+        const size_t hash = hashKeys(query);
+        const size_t mask = m_buckets.size() - 1;
+        for (size_t bucket = hash & mask; m_buckets[bucket]; bucket = (bucket + 1) & mask) {
+            const size_t begin = m_buckets[bucket] - 1;
+            if (m_entries[begin].hash != hash)
+                continue;
+            size_t end = begin + 1;
+            while (end < m_entries.size() && m_entries[end].hash == hash)
+                ++end;
+            return {begin, end};
+        }
+        return {0, 0};
+    }
+    const auto begin = std::partition_point(m_entries.begin(), m_entries.end(),
+                                            [this, query](const Entry &entry) {
+        return compareKeys(keysAt(entry.position), query) < 0;
+    });
+    const auto end = std::partition_point(begin, m_entries.end(), [this, query](const Entry &entry) {
+        return compareKeys(keysAt(entry.position), query) == 0;
+    });
+    return {size_t(begin - m_entries.begin()), size_t(end - m_entries.begin())};
+}
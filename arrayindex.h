@@ -0,0 +1,100 @@
+#pragma once
+
+#include "changetracker.h"
+#include "variant.h"
+
+#include <vector>
+
+// Secondary index over an Array of records, usually Objects, keyed by the values found at one
+// or more paths relative to each record. Records missing any of the paths are not indexed.
+//
+// A Hash index answers equality lookups through a hash table. A Sorted index also answers
+// range lookups, in the order given by compare(). Both match keys that compare() finds equal,
+// so numbers match by value whatever their type, and QString matches CompactString.
+//
+// The index keeps a shared copy of the array it was built from, so positions and references
+// returned by lookups stay valid, and an array modified since then no longer shares its data
+// with that copy, which isStale() reports. Reading the array through non-const access also
+// detaches it, so use const access to keep the index valid.
+class ArrayIndex
+{
+public:
+    enum class Kind {
+        Hash,
+        Sorted
+    };
+
+    ArrayIndex(Kind kind, std::vector<ValuePath> keyPaths);
+    ArrayIndex(Kind kind, ValuePath keyPath);
+
+    Kind kind() const noexcept { return m_kind; }
+    const std::vector<ValuePath> &keyPaths() const noexcept { return m_keyPaths; }
+
+    // Indexes array, splitting the work between up to threads threads; 0 uses one thread per
+    // hardware thread. Small arrays are indexed on the calling thread.
+    void rebuild(const Array &array, unsigned threads = 1);
+    // True if array is not the indexed one, or was modified since the last rebuild
+    bool isStale(const Array &array) const noexcept { return !m_array.isSharedWith(array); }
+
+    // The indexed array, positions returned by lookups refer to it
+    const Array &array() const noexcept { return m_array; }
+    // Number of indexed records
+    size_t size() const noexcept { return m_entries.size(); }
+
+    // Positions of the records whose key equals key, in ascending order. With several key
+    // paths, key is an Array holding one value per path.
+    std::vector<size_t> find(const Value &key) const;
+    // First record whose key equals key, or nullptr
+    const Value *findFirst(const Value &key) const;
+    // Positions of the records with lower <= key < upper, ordered by key. Throws
+    // std::logic_error for a Hash index.
+    std::vector<size_t> range(const Value &lower, const Value &upper) const;
+
+    // Order of a Sorted index, returns a negative number, 0 or a positive number. Null orders
+    // first, then booleans, numbers by exact value whatever their type with NaN last, strings
+    // and other types.
+    static int compare(const Value &lhs, const Value &rhs);
+
+private:
+    struct Step
+    {
+        ObjectKey key;
+        size_t index;
+        bool isIndex;
+    };
+
+    struct Entry
+    {
+        size_t hash;
+        size_t position;
+    };
+
+    using Keys = std::vector<const Value *>;
+
+    const Value *const *keysAt(size_t position) const
+    {
+        return m_keys.data() + position * m_keyPaths.size();
+    }
+    size_t hashKeys(const Value *const *keys) const noexcept;
+    int compareKeys(const Value *const *lhs, const Value *const *rhs) const;
+    // compareKeys() == 0, faster for strings
+    bool equalKeys(const Value *const *lhs, const Value *const *rhs) const;
+    bool lessEntry(const Entry &lhs, const Entry &rhs) const;
+    Keys queryKeys(const Value &key) const;
+    void indexChunk(size_t begin, size_t end, std::vector<Entry> &entries);
+    void buildBuckets();
+    // first entry not ordered before query and first entry ordered after it
+    std::pair<size_t, size_t> equalRange(const Value *const *query) const;
+
+    Kind m_kind;
+    std::vector<ValuePath> m_keyPaths;
+    std::vector<std::vector<Step>> m_steps;
+    Array m_array;
+    // m_keyPaths.size() pointers into m_array per record, null for missing paths
+    Keys m_keys;
+    // sorted by hash or by key, then by position
+    std::vector<Entry> m_entries;
+    // Hash index only: open addressing table of the first entry of each hash plus one, 0 for
+    // an empty bucket
+    std::vector<size_t> m_buckets;
+};
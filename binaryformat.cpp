@@ -0,0 +1,116 @@
+#include "binaryformat.h"
+
+#include <cstring>
+
+using BinaryFormat::Tag;
+
+namespace {
+
+void writeTag(QByteArray &out, Tag tag)
+{
+    out.append(char(tag));
+}
+
+void writeVarint(QByteArray &out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.append(char(uint8_t(value) | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+template<typename T>
+void writeFixed(QByteArray &out, T value)
+{
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "unsupported size");
+    using U = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+    U bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    char bytes[sizeof(U)];
+    for (size_t i = 0; i < sizeof(U); ++i)
+        bytes[i] = char(uint8_t(bits >> (8 * i)));
+    out.append(bytes, qsizetype(sizeof(bytes)));
+}
+
+void writeBytes(QByteArray &out, const char *data, size_t size)
+{
+    writeVarint(out, size);
+    out.append(data, qsizetype(size));
+}
+
+void writeString(QByteArray &out, const QString &s)
+{
+    const auto utf8 = s.toUtf8();
+    writeBytes(out, utf8.constData(), size_t(utf8.size()));
+}
+
+void writeString(QByteArray &out, const CompactString &s)
+{
+    writeBytes(out, s.data(), s.size());
+}
+
+void writeValue(QByteArray &out, const Value &value)
+{
+    auto visitor = [&out](const auto &v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::monostate>) {
+            writeTag(out, Tag::Null);
+        } else if constexpr (std::is_same_v<T, bool>) {
+            writeTag(out, v ? Tag::True : Tag::False);
+        } else if constexpr (std::is_same_v<T, int32_t>) {
+            writeTag(out, Tag::Int32);
+            writeFixed(out, v);
+        } else if constexpr (std::is_same_v<T, uint32_t>) {
+            writeTag(out, Tag::UInt32);
+            writeFixed(out, v);
+        } else if constexpr (std::is_same_v<T, int64_t>) {
+            writeTag(out, Tag::Int64);
+            writeFixed(out, v);
+        } else if constexpr (std::is_same_v<T, uint64_t>) {
+            writeTag(out, Tag::UInt64);
+            writeFixed(out, v);
+        } else if constexpr (std::is_same_v<T, double>) {
+            writeTag(out, Tag::Double);
+            writeFixed(out, v);
+        } else if constexpr (std::is_same_v<T, QString>) {
+            writeTag(out, Tag::String);
+            writeString(out, v);
+        } else if constexpr (std::is_same_v<T, CompactString>) {
+            writeTag(out, Tag::CompactString);
+            writeString(out, v);
+        } else if constexpr (std::is_same_v<T, QStringList>) {
+            writeTag(out, Tag::StringList);
+            writeVarint(out, uint64_t(v.size()));
+            for (const auto &item: v)
+                writeString(out, item);
+        } else if constexpr (std::is_same_v<T, Array>) {
+            writeTag(out, Tag::Array);
+            writeVarint(out, v.size());
+            for (const auto &item: v)
+                writeValue(out, item);
+        } else if constexpr (std::is_same_v<T, Object>) {
+            writeTag(out, Tag::Object);
+            writeVarint(out, v.size());
+            for (const auto &item: v) {
+                writeString(out, item.first);
+                writeValue(out, item.second);
+            }
+        } else if constexpr (std::is_same_v<T, DoubleArray> || std::is_same_v<T, Int64Array>) {
+            writeTag(out, std::is_same_v<T, DoubleArray> ? Tag::DoubleArray : Tag::Int64Array);
+            writeVarint(out, v.size());
+            for (const auto item: v)
+                writeFixed(out, item);
+        }
+    };
+    std::visit(visitor, static_cast<const ValueBase &>(value));
+}
+
+} // namespace
+
+QByteArray toBinary(const Value &value)
+{
+    QByteArray result;
+    writeValue(result, value);
+    return result;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "variant.h"
+
+#include <QtCore/QByteArray>
+
+#include <cstdint>
+
+// Native binary encoding of Values. Each value starts with a Tag byte:
+//  - Null, False and True have no payload
+//  - Int32, UInt32 have 4 bytes, Int64, UInt64 and Double have 8 bytes, little-endian
+//  - String and CompactString have a length followed by that many bytes of UTF-8
+//  - StringList has a count followed by the strings, each a length and UTF-8 bytes
+//  - Array has a count followed by the values
+//  - Object has a count followed by the entries, each a key (length and UTF-8) and a value
+//  - DoubleArray and Int64Array have a count followed by the 8 byte elements
+// Lengths and counts are unsigned LEB128 varints. Decode with PushParser.
+namespace BinaryFormat {
+
+enum class Tag : uint8_t {
+    Null,
+    False,
+    True,
+    Int32,
+    UInt32,
+    Int64,
+    UInt64,
+    Double,
+    String,
+    StringList,
+    Array,
+    Object,
+    DoubleArray,
+    Int64Array,
+    CompactString
+};
+
+// Longest varint, enough for 64 bits
+constexpr int MaxVarintSize = 10;
+
+} // namespace BinaryFormat
+
+QByteArray toBinary(const Value &value);
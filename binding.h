@@ -0,0 +1,331 @@
+#pragma once
+
+#include "variant.h"
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Compile-time description of a C++ struct, used to convert it to and from an Object.
+// Specialize ValueBinding for a type and list its fields once:
+//
+//     template<> struct ValueBinding<Point>
+//     {
+//         static constexpr auto fields = std::make_tuple(
+//                 field("x", &Point::x),
+//                 field("y", &Point::y));
+//     };
+//
+// Supported member types are the Value alternatives, other bound structs, enums,
+// std::vector and std::optional of supported types. Field names must be Latin-1.
+template<typename T>
+struct ValueBinding;
+
+enum class BindingError {
+    NoError,
+    NotAnObject,
+    NotAnArray,
+    MissingField,
+    TypeMismatch,
+    // a number the member type does not represent exactly
+    OutOfRange
+};
+
+struct BindingStatus
+{
+    BindingError error{BindingError::NoError};
+    // name of the innermost field that failed, if any
+    const char *field{nullptr};
+
+    bool ok() const noexcept { return error == BindingError::NoError; }
+};
+
+namespace BindingDetail {
+
+constexpr uint64_t FnvOffset = 0xcbf29ce484222325ull;
+constexpr uint64_t FnvPrime = 0x100000001b3ull;
+
+constexpr uint64_t keyHash(const char *name) noexcept
+{
+    uint64_t hash = FnvOffset;
+    for (; *name; ++name)
+        hash = (hash ^ uint8_t(*name)) * FnvPrime;
+    return hash;
+}
+
+// Same as above, so the result matches the compile-time hash of a Latin-1 name
+inline uint64_t keyHash(const QString &key) noexcept
+{
+    uint64_t hash = FnvOffset;
+    for (const QChar c: key)
+        hash = (hash ^ c.unicode()) * FnvPrime;
+    return hash;
+}
+
+inline uint64_t keyHash(const CompactString &key)
+{
+    if (!key.isAscii())
+        return keyHash(key.toQString());
+    uint64_t hash = FnvOffset;
+    for (size_t i = 0; i < key.size(); ++i)
+        hash = (hash ^ uint8_t(key.data()[i])) * FnvPrime;
+    return hash;
+}
+
+inline bool keyEquals(const CompactString &key, const char *name)
+{
+    if (key.isAscii())
+        return std::strlen(name) == key.size() && std::memcmp(key.data(), name, key.size()) == 0;
+    return key.equals(QString::fromLatin1(name));
+}
+
+inline bool keyEquals(const QString &key, const char *name) noexcept
+{
+    const QChar *data = key.constData();
+    const qsizetype size = key.size();
+    qsizetype i = 0;
+    for (; i < size && name[i]; ++i) {
+        if (data[i].unicode() != uint8_t(name[i]))
+            return false;
+    }
+    return i == size && !name[i];
+}
+
+template<typename T, typename = void>
+struct IsBound : std::false_type {};
+template<typename T>
+struct IsBound<T, std::void_t<decltype(ValueBinding<T>::fields)>> : std::true_type {};
+
+template<typename T>
+struct IsVector : std::false_type {};
+template<typename T, typename A>
+struct IsVector<std::vector<T, A>> : std::true_type {};
+
+template<typename T>
+struct IsOptional : std::false_type {};
+template<typename T>
+struct IsOptional<std::optional<T>> : std::true_type {};
+
+template<typename T>
+constexpr bool IsNumber = std::is_arithmetic_v<T> && !std::is_same_v<T, bool>;
+
+} // namespace BindingDetail
+
+template<typename T, typename M>
+struct Field
+{
+    using Type = M;
+
+    const char *name;
+    M T::*member;
+    uint64_t keyHash;
+};
+
+template<typename T, typename M>
+constexpr Field<T, M> field(const char *name, M T::*member)
+{
+    return {name, member, BindingDetail::keyHash(name)};
+}
+
+template<typename T>
+Value toValue(const T &object);
+template<typename T>
+BindingStatus fromValue(const Value &value, T &result);
+
+namespace BindingDetail {
+
+template<typename T>
+constexpr size_t fieldCount()
+{
+    return std::tuple_size_v<std::decay_t<decltype(ValueBinding<T>::fields)>>;
+}
+
+template<typename T, size_t I>
+const auto &fieldAt()
+{
+    return std::get<I>(ValueBinding<T>::fields);
+}
+
+// Keys are created once per field and then shared by all produced objects
+template<typename T, size_t I>
+const Object::Key &fieldKey()
+{
+    static const Object::Key key = QString::fromLatin1(fieldAt<T, I>().name);
+    return key;
+}
+
+template<typename M>
+Value memberToValue(const M &member)
+{
+    if constexpr (IsBound<M>::value) {
+        return toValue(member);
+    } else if constexpr (std::is_enum_v<M>) {
+        return Value(int64_t(member));
+    } else if constexpr (IsOptional<M>::value) {
+        return member ? memberToValue(*member) : Value();
+    } else if constexpr (IsVector<M>::value) {
+        Array result;
+        result.reserve(member.size());
+        for (const auto &item: member)
+            result.append(memberToValue(item));
+        return result;
+    } else {
+        return Value(member);
+    }
+}
+
+template<typename M>
+BindingStatus memberFromValue(const Value &value, M &member)
+{
+    if constexpr (IsBound<M>::value) {
+        return fromValue(value, member);
+    } else if constexpr (std::is_enum_v<M>) {
+        using U = std::underlying_type_t<M>;
+        U underlying{};
+        const auto status = memberFromValue(value, underlying);
+        if (status.ok())
+            member = M(underlying);
+        return status;
+    } else if constexpr (IsOptional<M>::value) {
+        if (value.isNull()) {
+            member.reset();
+            return {};
+        }
+        typename M::value_type item{};
+        const auto status = memberFromValue(value, item);
+        if (status.ok())
+            member = std::move(item);
+        return status;
+    } else if constexpr (IsVector<M>::value) {
+        const auto array = value.getIf<Array>();
+        if (!array)
+            return {BindingError::NotAnArray};
+        member.clear();
+        member.reserve(array->size());
+        for (const auto &item: *array) {
+            typename M::value_type element{};
+            const auto status = memberFromValue(item, element);
+            if (!status.ok())
+                return status;
+            member.push_back(std::move(element));
+        }
+        return {};
+    } else if constexpr (IsNumber<M>) {
+        auto visitor = [&member](const auto &v) -> BindingError {
+            using V = std::decay_t<decltype(v)>;
+            if constexpr (IsNumber<V>) {
+                const auto result = exactCast<M>(v);
+                if (!result)
+                    return BindingError::OutOfRange;
+                member = *result;
+                return BindingError::NoError;
+            } else {
+                return BindingError::TypeMismatch;
+            }
+        };
+        return {std::visit(visitor, static_cast<const ValueBase &>(value))};
+    } else {
+        const auto result = value.getIf<M>();
+        if (!result)
+            return {BindingError::TypeMismatch};
+        member = *result;
+        return {};
+    }
+}
+
+template<typename T, size_t... I>
+void insertFields(const T &object, Object &result, std::index_sequence<I...>)
+{
+    const auto insertField = [&](const auto &field, const Object::Key &key) {
+        using M = typename std::decay_t<decltype(field)>::Type;
+        const auto &member = object.*field.member;
+        if constexpr (IsOptional<M>::value) {
+            if (!member)
+                return;
+        }
+        result.insert({key, memberToValue(member)});
+    };
+    (insertField(fieldAt<T, I>(), fieldKey<T, I>()), ...);
+}
+
+template<typename T, size_t... I>
+BindingStatus assignField(const Object::Key &key, uint64_t hash, const Value &value, T &result,
+                          bool *found, std::index_sequence<I...>)
+{
+    BindingStatus status;
+    const auto tryField = [&](const auto &field, bool &fieldFound) {
+        if (field.keyHash != hash || !keyEquals(key, field.name))
+            return false;
+        fieldFound = true;
+        status = memberFromValue(value, result.*field.member);
+        if (!status.ok() && !status.field)
+            status.field = field.name;
+        return true;
+    };
+    (void)(tryField(fieldAt<T, I>(), found[I]) || ...);
+    return status;
+}
+
+template<typename T, size_t... I>
+BindingStatus checkMissing(T &result, const bool *found, std::index_sequence<I...>)
+{
+    BindingStatus status;
+    const auto checkField = [&](const auto &field, bool fieldFound) {
+        using M = typename std::decay_t<decltype(field)>::Type;
+        if (fieldFound)
+            return false;
+        if constexpr (IsOptional<M>::value) {
+            (result.*field.member).reset();
+            return false;
+        } else {
+            status = {BindingError::MissingField, field.name};
+            return true;
+        }
+    };
+    (void)(checkField(fieldAt<T, I>(), found[I]) || ...);
+    return status;
+}
+
+} // namespace BindingDetail
+
+template<typename T>
+Value toValue(const T &object)
+{
+    static_assert(BindingDetail::IsBound<T>::value, "ValueBinding<T> is not specialized");
+    constexpr size_t count = BindingDetail::fieldCount<T>();
+    Object result;
+    result.reserve(count);
+    BindingDetail::insertFields(object, result, std::make_index_sequence<count>());
+    return result;
+}
+
+// Fills result from an Object produced by toValue(), without throwing.
+// Keys are matched in a single pass over the object using compile-time hashes of the field
+// names. Unknown keys are ignored, missing keys are an error unless the field is optional.
+// Numbers convert between the numeric types only when the member represents them exactly,
+// otherwise the error is OutOfRange.
+template<typename T>
+BindingStatus fromValue(const Value &value, T &result)
+{
+    static_assert(BindingDetail::IsBound<T>::value, "ValueBinding<T> is not specialized");
+    constexpr size_t count = BindingDetail::fieldCount<T>();
+    using Indexes = std::make_index_sequence<count>;
+
+    const auto object = value.getIf<Object>();
+    if (!object)
+        return {BindingError::NotAnObject};
+
+    bool found[count + 1] = {};
+    for (const auto &item: *object) {
+        const auto hash = BindingDetail::keyHash(item.first);
+        const auto status = BindingDetail::assignField(
+                item.first, hash, item.second, result, found, Indexes());
+        if (!status.ok())
+            return status;
+    }
+    return BindingDetail::checkMissing(result, found, Indexes());
+}
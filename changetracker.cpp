@@ -0,0 +1,276 @@
+#include "changetracker.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+ValuePath ValuePath::child(Step step) const
+{
+    ValuePath result(*this);
+    result.m_steps.push_back(std::move(step));
+    return result;
+}
+
+bool ValuePath::startsWith(const ValuePath &prefix) const
+{
+    return prefix.size() <= size()
+            && std::equal(prefix.m_steps.begin(), prefix.m_steps.end(), m_steps.begin());
+}
+
+QString ValuePath::toString() const
+{
+    QString result;
+    for (const auto &step: m_steps) {
+        result += QChar('/');
+        if (step.isIndex()) {
+            result += QString::number(qint64(step.index()));
+            continue;
+        }
+        for (const QChar c: step.key()) {
+            if (c == QChar('~'))
+                result += QString::fromLatin1("~0");
+            else if (c == QChar('/'))
+                result += QString::fromLatin1("~1");
+            else
+                result += c;
+        }
+    }
+    return result;
+}
+
+// Version tree, only holds nodes for the paths changed so far
+struct ChangeTracker::Node
+{
+    static constexpr size_t npos = size_t(-1);
+
+    uint64_t version{0};
+    // version of the children that have no node
+    uint64_t baseline{0};
+    // array children from this index on were moved by an insertion, they have shiftedVersion
+    size_t shiftedFrom{npos};
+    uint64_t shiftedVersion{0};
+    // versions of the array children appended from index appendedFrom on, which have no node
+    size_t appendedFrom{0};
+    std::vector<uint64_t> appended;
+    std::map<ValuePath::Step, std::unique_ptr<Node>> children;
+
+    uint64_t childVersion(const ValuePath::Step &step) const
+    {
+        if (!step.isIndex())
+            return baseline;
+        const size_t index = step.index();
+        if (index >= appendedFrom && index - appendedFrom < appended.size())
+            return appended[index - appendedFrom];
+        return index >= shiftedFrom ? shiftedVersion : baseline;
+    }
+
+    // Gives the appended children nodes, so that appended can start again elsewhere
+    void detachAppended()
+    {
+        for (size_t i = 0; i < appended.size(); ++i) {
+            auto &child = children[ValuePath::Step(appendedFrom + i)];
+            if (!child) {
+                child = std::make_unique<Node>();
+                child->version = child->baseline = appended[i];
+            }
+        }
+        appended.clear();
+    }
+};
+
+ChangeTracker::ChangeTracker(Value root)
+    : m_root(std::move(root))
+    , m_versions(std::make_unique<Node>())
+{
+}
+
+ChangeTracker::~ChangeTracker() = default;
+
+Value &ChangeTracker::edit(const ValuePath &path)
+{
+    auto &result = resolve(path);
+    // the caller can change anything below the node
+    auto &node = touch(path);
+    node.children.clear();
+    node.baseline = m_stamp;
+    node.shiftedFrom = Node::npos;
+    node.appended.clear();
+    log(path);
+    return result;
+}
+
+void ChangeTracker::set(const ValuePath &path, Value value)
+{
+    edit(path) = std::move(value);
+}
+
+bool ChangeTracker::insert(const ValuePath &objectPath, const QString &key, Value value)
+{
+    auto &object = resolveObject(objectPath);
+    if (!object.insert({key, std::move(value)}).second)
+        return false;
+    const auto path = objectPath.child(key);
+    touch(path);
+    log(path);
+    return true;
+}
+
+size_t ChangeTracker::erase(const ValuePath &objectPath, const QString &key)
+{
+    if (!resolveObject(objectPath).erase(key))
+        return 0;
+    const auto path = objectPath.child(key);
+    auto &node = touch(path);
+    node.children.clear();
+    node.baseline = m_stamp;
+    node.shiftedFrom = Node::npos;
+    node.appended.clear();
+    log(path);
+    return 1;
+}
+
+void ChangeTracker::append(const ValuePath &arrayPath, Value value)
+{
+    auto &array = resolveArray(arrayPath);
+    const auto index = array.size();
+    array.append(std::move(value));
+
+    // the new element gets a version of its own, the others keep theirs. Consecutive appends
+    // only add to the versions of the array node, without a node per element.
+    auto &node = touch(arrayPath);
+    if (!node.appended.empty() && node.appendedFrom + node.appended.size() != index)
+        node.detachAppended();
+    if (node.appended.empty())
+        node.appendedFrom = index;
+    node.children.erase(ValuePath::Step(index));
+    node.appended.push_back(m_stamp);
+    log(arrayPath.child(index));
+}
+
+void ChangeTracker::insert(const ValuePath &arrayPath, size_t index, Value value)
+{
+    auto &array = resolveArray(arrayPath);
+    if (index > array.size())
+        throw std::out_of_range("ChangeTracker::insert: index out of range");
+    array.insert(array.begin() + std::ptrdiff_t(index), std::move(value));
+
+    // the elements from index on moved, so all of them changed
+    auto &node = touch(arrayPath);
+    node.children.erase(node.children.lower_bound(ValuePath::Step(index)),
+                        node.children.lower_bound(ValuePath::Step(QString())));
+    if (index <= node.appendedFrom)
+        node.appended.clear();
+    else if (index - node.appendedFrom < node.appended.size())
+        node.appended.resize(index - node.appendedFrom);
+    node.shiftedFrom = std::min(node.shiftedFrom, index);
+    node.shiftedVersion = m_stamp;
+    log(arrayPath);
+}
+
+uint64_t ChangeTracker::version(const ValuePath &path) const
+{
+    const Node *node = m_versions.get();
+    for (const auto &step: path.steps()) {
+        const auto it = node->children.find(step);
+        if (it == node->children.end())
+            return node->childVersion(step);
+        node = it->second.get();
+    }
+    return node->version;
+}
+
+std::vector<ValuePath> ChangeTracker::takeChanges()
+{
+    std::vector<std::pair<uint64_t, ValuePath>> changes;
+    changes.reserve(m_changes.size());
+    for (auto &change: std::exchange(m_changes, {}))
+        changes.emplace_back(change.second, change.first);
+    std::sort(changes.begin(), changes.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs.first < rhs.first;
+    });
+    std::vector<ValuePath> result;
+    result.reserve(changes.size());
+    for (auto &change: changes)
+        result.push_back(std::move(change.second));
+    return result;
+}
+
+size_t ChangeTracker::addListener(Listener listener)
+{
+    const auto id = m_nextListener++;
+    m_listeners.emplace_back(id, std::move(listener));
+    return id;
+}
+
+void ChangeTracker::removeListener(size_t id)
+{
+    m_listeners.erase(std::remove_if(m_listeners.begin(), m_listeners.end(),
+                                     [id](const auto &listener) { return listener.first == id; }),
+                      m_listeners.end());
+}
+
+Value &ChangeTracker::resolve(const ValuePath &path)
+{
+    Value *value = &m_root;
+    for (const auto &step: path.steps()) {
+        if (step.isIndex()) {
+            if (value->type() != Value::Type::Array || step.index() >= value->get<Array>().size())
+                throw std::out_of_range("ChangeTracker: no such path");
+            value = &value->get<Array>()[step.index()];
+        } else {
+            if (value->type() != Value::Type::Object || !value->get<Object>().contains(step.key()))
+                throw std::out_of_range("ChangeTracker: no such path");
+            value = &value->get<Object>()[step.key()];
+        }
+    }
+    return *value;
+}
+
+Object &ChangeTracker::resolveObject(const ValuePath &path)
+{
+    auto &value = resolve(path);
+    if (value.type() != Value::Type::Object)
+        throw std::out_of_range("ChangeTracker: not an Object");
+    return value.get<Object>();
+}
+
+Array &ChangeTracker::resolveArray(const ValuePath &path)
+{
+    auto &value = resolve(path);
+    if (value.type() != Value::Type::Array)
+        throw std::out_of_range("ChangeTracker: not an Array");
+    return value.get<Array>();
+}
+
+auto ChangeTracker::touch(const ValuePath &path) -> Node &
+{
+    const auto stamp = ++m_stamp;
+    Node *node = m_versions.get();
+    node->version = stamp;
+    for (const auto &step: path.steps()) {
+        auto &child = node->children[step];
+        if (!child) {
+            // a node not seen so far inherits the version of its position
+            child = std::make_unique<Node>();
+            child->baseline = node->childVersion(step);
+        }
+        child->version = stamp;
+        node = child.get();
+    }
+    return *node;
+}
+
+void ChangeTracker::log(const ValuePath &path)
+{
+    for (const auto &listener: m_listeners)
+        listener.second(path);
+
+    // paths between an ancestor and path start with the ancestor, and none is logged below
+    // another one, so a logged ancestor is the path right before
+    auto it = m_changes.upper_bound(path);
+    if (it != m_changes.begin() && path.startsWith(std::prev(it)->first))
+        return;
+    while (it != m_changes.end() && it->first.startsWith(path))
+        it = m_changes.erase(it);
+    m_changes.emplace_hint(it, path, m_sequence++);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "variant.h"
+
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Location of a node in a Value tree, as a sequence of object keys and array indexes
+class ValuePath
+{
+public:
+    class Step
+    {
+    public:
+        Step(const QString &key) : m_key(key) {}
+        Step(const char *key) : m_key(QString::fromUtf8(key)) {}
+        Step(size_t index) : m_index(index) {}
+        Step(int index) : m_index(size_t(index)) {}
+
+        bool isIndex() const noexcept { return m_index != npos; }
+        const QString &key() const noexcept { return m_key; }
+        size_t index() const noexcept { return m_index; }
+
+        bool operator==(const Step &other) const
+        { return m_index == other.m_index && m_key == other.m_key; }
+        bool operator!=(const Step &other) const { return !(*this == other); }
+        // indexes order before keys
+        bool operator<(const Step &other) const
+        { return m_index != other.m_index ? m_index < other.m_index : m_key < other.m_key; }
+
+    private:
+        static constexpr size_t npos = size_t(-1);
+
+        QString m_key;
+        size_t m_index{npos};
+    };
+
+    ValuePath() = default;
+    ValuePath(std::initializer_list<Step> steps) : m_steps(steps) {}
+
+    bool isEmpty() const noexcept { return m_steps.empty(); }
+    size_t size() const noexcept { return m_steps.size(); }
+    const Step &at(size_t i) const { return m_steps.at(i); }
+    const std::vector<Step> &steps() const noexcept { return m_steps; }
+
+    ValuePath child(Step step) const;
+    // True if prefix is this path or one of its ancestors
+    bool startsWith(const ValuePath &prefix) const;
+    // JSON Pointer notation, such as "/targets/3/flags"
+    QString toString() const;
+
+    bool operator==(const ValuePath &other) const { return m_steps == other.m_steps; }
+    bool operator!=(const ValuePath &other) const { return m_steps != other.m_steps; }
+    // Step by step, so a path sorts right before the paths below it
+    bool operator<(const ValuePath &other) const { return m_steps < other.m_steps; }
+
+private:
+    std::vector<Step> m_steps;
+};
+
+// Owns a Value tree and records the changes made through it.
+//
+// Every container has a version, a stamp that grows whenever the container or anything below
+// it is changed through the tracker, so derived data computed for a subtree stays valid while
+// the version at its path does not change. Changed paths are also appended to a log that
+// consumers drain with takeChanges(); the log is kept compact by dropping paths below an
+// already logged one.
+//
+// Tracking is layered on top of the tree, plain Object and Array operations cost the same as
+// without it. Changes made through references obtained from edit() are attributed to the
+// edited path.
+class ChangeTracker
+{
+public:
+    // Called with the changed path after each change; must not modify the tracker
+    using Listener = std::function<void(const ValuePath &path)>;
+
+    explicit ChangeTracker(Value root = {});
+    ~ChangeTracker();
+
+    const Value &root() const noexcept { return m_root; }
+
+    // Returns the node at path for modification and records the whole node as changed.
+    // Throws std::out_of_range if there is no such node.
+    Value &edit(const ValuePath &path);
+    void set(const ValuePath &path, Value value);
+
+    // Object operations on the Object at objectPath
+    bool insert(const ValuePath &objectPath, const QString &key, Value value);
+    size_t erase(const ValuePath &objectPath, const QString &key);
+
+    // Array operations on the Array at arrayPath
+    void append(const ValuePath &arrayPath, Value value);
+    void insert(const ValuePath &arrayPath, size_t index, Value value);
+
+    // Version of the node at path, 0 if it was not changed since the tracker was created
+    uint64_t version(const ValuePath &path = {}) const;
+
+    bool hasChanges() const noexcept { return !m_changes.empty(); }
+    // Returns the paths changed since the last call, in the order of the first change
+    std::vector<ValuePath> takeChanges();
+
+    // Returns an id for removeListener()
+    size_t addListener(Listener listener);
+    void removeListener(size_t id);
+
+private:
+    struct Node;
+
+    Value &resolve(const ValuePath &path);
+    Object &resolveObject(const ValuePath &path);
+    Array &resolveArray(const ValuePath &path);
+    // Stamps the nodes on the path, the last one is returned
+    Node &touch(const ValuePath &path);
+    // Adds path to the log and notifies the listeners
+    void log(const ValuePath &path);
+
+    Value m_root;
+    std::unique_ptr<Node> m_versions;
+    uint64_t m_stamp{0};
+    // logged paths, none below another one, with the sequence number of their first change
+    std::map<ValuePath, uint64_t> m_changes;
+    uint64_t m_sequence{0};
+    std::vector<std::pair<size_t, Listener>> m_listeners;
+    size_t m_nextListener{0};
+};
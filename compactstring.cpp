@@ -0,0 +1,265 @@
+#include "compactstring.h"
+
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+bool isAsciiData(const char *data, size_t size) noexcept
+{
+    unsigned char bits = 0;
+    for (size_t i = 0; i < size; ++i)
+        bits |= static_cast<unsigned char>(data[i]);
+    return bits < 0x80;
+}
+
+// Rejects overlong forms, surrogates, code points above U+10FFFF and truncated sequences
+bool isValidUtf8(const char *data, size_t size) noexcept
+{
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size;) {
+        const unsigned char lead = bytes[i++];
+        if (lead < 0x80)
+            continue;
+        size_t extra;
+        unsigned char min = 0x80;
+        unsigned char max = 0xbf;
+        if (lead < 0xc2) {
+            return false;
+        } else if (lead < 0xe0) {
+            extra = 1;
+        } else if (lead < 0xf0) {
+            extra = 2;
+            if (lead == 0xe0)
+                min = 0xa0;
+            else if (lead == 0xed)
+                max = 0x9f;
+        } else if (lead < 0xf5) {
+            extra = 3;
+            if (lead == 0xf0)
+                min = 0x90;
+            else if (lead == 0xf4)
+                max = 0x8f;
+        } else {
+            return false;
+        }
+        if (size - i < extra || bytes[i] < min || bytes[i] > max)
+            return false;
+        for (size_t end = i + extra; ++i < end;) {
+            if ((bytes[i] & 0xc0) != 0x80)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Keys and values are usually short, decode them on the stack
+constexpr size_t StackBufferSize = 256;
+static_assert(StackBufferSize % StringKernels::Utf16Hasher::BlockChars == 0,
+              "hash() feeds the hasher whole blocks");
+
+} // namespace
+
+CompactString::CompactString(const char *utf8, size_t size)
+    : m_inline{}
+    , m_size(AsciiFlag)
+{
+    if (isAsciiData(utf8, size))
+        assign(utf8, size, true);
+    else if (isValidUtf8(utf8, size))
+        assign(utf8, size, false);
+    else
+        *this = CompactString(QString::fromUtf8(utf8, qsizetype(size)));
+}
+
+CompactString::CompactString(QLatin1String s)
+    : m_inline{}
+    , m_size(AsciiFlag)
+{
+    const auto size = size_t(s.size());
+    if (isAsciiData(s.data(), size))
+        assign(s.data(), size, true);
+    else
+        *this = CompactString(QString(s));
+}
+
+CompactString::CompactString(const QString &s)
+    : m_inline{}
+    , m_size(AsciiFlag)
+{
+    const auto size = size_t(s.size());
+    const QChar *chars = s.constData();
+    bool ascii = true;
+    for (size_t i = 0; i < size && ascii; ++i)
+        ascii = chars[i].unicode() < 0x80;
+
+    if (!ascii) {
+        const QByteArray utf8 = s.toUtf8();
+        assign(utf8.constData(), size_t(utf8.size()), false);
+        return;
+    }
+
+    char buffer[StackBufferSize];
+    std::vector<char> heapBuffer;
+    char *narrow = buffer;
+    if (size > StackBufferSize) {
+        heapBuffer.resize(size);
+        narrow = heapBuffer.data();
+    }
+    for (size_t i = 0; i < size; ++i)
+        narrow[i] = char(chars[i].unicode());
+    assign(narrow, size, true);
+}
+
+void CompactString::assign(const char *utf8, size_t size, bool ascii)
+{
+    if (size > SizeMask)
+        throw std::length_error("CompactString is too long");
+    m_size = uint32_t(size) | (ascii ? AsciiFlag : 0);
+    if (size <= InlineCapacity) {
+        std::memcpy(m_inline, utf8, size);
+        return;
+    }
+    void *block = ::operator new(sizeof(Header) + size);
+    Header *header = new (block) Header{{1}};
+    std::memcpy(m_inline, &header, sizeof(header));
+    std::memcpy(heapData(), utf8, size);
+}
+
+size_t CompactString::utf16Size() const noexcept
+{
+    if (isAscii())
+        return size();
+    // one unit per character, two for the four byte sequences
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data());
+    size_t result = 0;
+    for (size_t i = 0; i < size(); ++i)
+        result += ((bytes[i] & 0xc0) != 0x80) + (bytes[i] >= 0xf0);
+    return result;
+}
+
+// The data is valid UTF-8, the constructors make sure of it
+size_t CompactString::toUtf16(size_t &pos, char16_t *buffer, size_t capacity) const noexcept
+{
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data());
+    const size_t length = size();
+    size_t result = 0;
+    if (isAscii()) {
+        const size_t count = std::min(length - pos, capacity);
+        for (; result < count; ++result)
+            buffer[result] = bytes[pos++];
+        return result;
+    }
+
+    while (pos < length && result + 2 <= capacity) {
+        uint32_t codePoint = bytes[pos];
+        size_t extra = 0;
+        if (codePoint >= 0xf0) {
+            codePoint &= 0x07;
+            extra = 3;
+        } else if (codePoint >= 0xe0) {
+            codePoint &= 0x0f;
+            extra = 2;
+        } else if (codePoint >= 0xc0) {
+            codePoint &= 0x1f;
+            extra = 1;
+        }
+        ++pos;
+        for (; extra > 0 && pos < length; --extra, ++pos)
+            codePoint = (codePoint << 6) | (bytes[pos] & 0x3f);
+        if (codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            buffer[result++] = char16_t(0xd800 + (codePoint >> 10));
+            buffer[result++] = char16_t(0xdc00 + (codePoint & 0x3ff));
+        } else {
+            buffer[result++] = char16_t(codePoint);
+        }
+    }
+    return result;
+}
+
+QString CompactString::toQString() const
+{
+    if (isAscii())
+        return QString::fromLatin1(data(), qsizetype(size()));
+    return QString::fromUtf8(data(), qsizetype(size()));
+}
+
+// Long strings are decoded piecewise into a stack buffer, so neither hash() nor equals()
+// allocates
+size_t CompactString::hash(size_t seed) const noexcept
+{
+    if (isAscii())
+        return StringKernels::hashLatin1(data(), size(), seed);
+    // UTF-16 never needs more code units than UTF-8 needs bytes; one spare unit takes the
+    // second half of a surrogate pair that does not fit into a piece
+    char16_t buffer[StackBufferSize + 1];
+    size_t pos = 0;
+    if (size() <= StackBufferSize) {
+        const auto length = toUtf16(pos, buffer, StackBufferSize);
+        return StringKernels::hashUtf16(buffer, length, seed);
+    }
+    StringKernels::Utf16Hasher hasher(utf16Size(), seed);
+    size_t filled = 0;
+    while (pos < size()) {
+        filled += toUtf16(pos, buffer + filled, StackBufferSize + 1 - filled);
+        if (filled >= StackBufferSize) {
+            hasher.add(buffer, StackBufferSize);
+            filled -= StackBufferSize;
+            buffer[0] = buffer[StackBufferSize];
+        }
+    }
+    hasher.add(buffer, filled);
+    return hasher.result();
+}
+
+bool CompactString::equals(QStringView other) const noexcept
+{
+    const auto otherSize = size_t(other.size());
+    const auto *chars = reinterpret_cast<const char16_t *>(other.utf16());
+    if (isAscii()) {
+        if (otherSize != size())
+            return false;
+        const char *bytes = data();
+        for (size_t i = 0; i < otherSize; ++i) {
+            if (chars[i] != char16_t(bytes[i]))
+                return false;
+        }
+        return true;
+    }
+    // a non-ASCII character takes at least two UTF-8 bytes but at most two UTF-16 units
+    if (otherSize > size() || otherSize * 3 < size())
+        return false;
+
+    char16_t buffer[StackBufferSize];
+    size_t offset = 0;
+    for (size_t pos = 0; pos < size();) {
+        const auto length = toUtf16(pos, buffer, StackBufferSize);
+        if (length > otherSize - offset
+            || !StringKernels::equalUtf16(buffer, chars + offset, length)) {
+            return false;
+        }
+        offset += length;
+    }
+    return offset == otherSize;
+}
+
+int CompactString::compare(QStringView other) const noexcept
+{
+    const auto otherSize = size_t(other.size());
+    const auto *chars = reinterpret_cast<const char16_t *>(other.utf16());
+    char16_t buffer[StackBufferSize];
+    size_t offset = 0;
+    for (size_t pos = 0; pos < size();) {
+        const auto length = toUtf16(pos, buffer, StackBufferSize);
+        const auto common = std::min(length, otherSize - offset);
+        const auto mismatch = std::mismatch(buffer, buffer + common, chars + offset);
+        if (mismatch.first != buffer + common)
+            return *mismatch.first < *mismatch.second ? -1 : 1;
+        if (common < length)
+            return 1;
+        offset += length;
+    }
+    return offset < otherSize ? -1 : 0;
+}
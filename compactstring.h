@@ -0,0 +1,213 @@
+#pragma once
+
+#include "stringkernels.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QStringView>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Immutable UTF-8 string with inline storage for short values. Longer values are kept in a
+// shared heap block, so copies are cheap. Compares equal to, hashes like and sorts like the
+// QString with the same text, so it can be used interchangeably with QString as a key.
+// Invalid UTF-8 is replaced the way QString::fromUtf8() does it, so the text is always the
+// one QString::fromUtf8() gives for the same bytes. The other way around, a QString with
+// unpaired surrogates has no UTF-8 form: they are replaced as by QString::toUtf8(), so such a
+// CompactString neither equals nor hashes like the QString it was made of.
+class CompactString
+{
+public:
+    // Strings up to this size (in UTF-8 bytes) do not allocate
+    static constexpr size_t InlineCapacity = 20;
+
+    CompactString() noexcept;
+    CompactString(const char *utf8);
+    CompactString(const char *utf8, size_t size);
+    CompactString(QLatin1String s);
+    CompactString(const QString &s);
+    CompactString(const CompactString &other) noexcept;
+    CompactString(CompactString &&other) noexcept;
+    CompactString &operator=(const CompactString &other) noexcept;
+    CompactString &operator=(CompactString &&other) noexcept;
+    ~CompactString();
+
+    const char *data() const noexcept { return isInline() ? m_inline : heapData(); }
+    // Size in UTF-8 bytes
+    size_t size() const noexcept { return m_size & SizeMask; }
+    bool empty() const noexcept { return size() == 0; }
+    bool isEmpty() const noexcept { return empty(); }
+    bool isAscii() const noexcept { return (m_size & AsciiFlag) != 0; }
+    bool isInline() const noexcept { return size() <= InlineCapacity; }
+    // Number of bytes allocated outside of the object, shared between copies
+    size_t heapSize() const noexcept;
+
+    QString toQString() const;
+    QByteArray toUtf8() const { return QByteArray(data(), qsizetype(size())); }
+
+    // Same as StringKernels::hash(toQString(), seed); hashes ASCII data without converting it
+    size_t hash(size_t seed = 0) const noexcept;
+
+    bool equals(const CompactString &other) const noexcept;
+    bool equals(QStringView other) const noexcept;
+    bool equals(const QString &other) const noexcept { return equals(QStringView(other)); }
+    // Negative, zero or positive like QString::compare(), by UTF-16 code units
+    int compare(QStringView other) const noexcept;
+
+private:
+    struct Header
+    {
+        std::atomic<uint32_t> ref;
+    };
+
+    static constexpr uint32_t AsciiFlag = 0x80000000u;
+    static constexpr uint32_t SizeMask = 0x7fffffffu;
+
+    Header *heap() const noexcept
+    {
+        Header *result;
+        std::memcpy(&result, m_inline, sizeof(result));
+        return result;
+    }
+    char *heapData() const noexcept { return reinterpret_cast<char *>(heap() + 1); }
+    void assign(const char *utf8, size_t size, bool ascii);
+    void release() noexcept;
+
+    // Length in UTF-16 code units
+    size_t utf16Size() const noexcept;
+    // Decodes the UTF-8 data from byte offset pos into UTF-16 until the end of the data or
+    // until less than two units of capacity are left, so a surrogate pair is never split.
+    // Advances pos and returns the number of units written.
+    size_t toUtf16(size_t &pos, char16_t *buffer, size_t capacity) const noexcept;
+
+    // holds the characters or, for long strings, the Header pointer; not a union with a
+    // pointer, as that would round the inline part up to 24 bytes
+    alignas(Header *) char m_inline[InlineCapacity];
+    uint32_t m_size;
+};
+
+inline CompactString::CompactString() noexcept
+    : m_inline{}
+    , m_size(AsciiFlag)
+{
+}
+
+inline CompactString::CompactString(const char *utf8)
+    : CompactString(utf8, std::strlen(utf8))
+{
+}
+
+inline CompactString::CompactString(const CompactString &other) noexcept
+    : m_size(other.m_size)
+{
+    if (isInline()) {
+        std::memcpy(m_inline, other.m_inline, InlineCapacity);
+    } else {
+        std::memcpy(m_inline, other.m_inline, sizeof(Header *));
+        heap()->ref.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+inline CompactString::CompactString(CompactString &&other) noexcept
+    : m_size(other.m_size)
+{
+    std::memcpy(m_inline, other.m_inline, InlineCapacity);
+    other.m_size = AsciiFlag;
+}
+
+inline CompactString &CompactString::operator=(const CompactString &other) noexcept
+{
+    if (this != &other) {
+        CompactString copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+inline CompactString &CompactString::operator=(CompactString &&other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_size = other.m_size;
+        std::memcpy(m_inline, other.m_inline, InlineCapacity);
+        other.m_size = AsciiFlag;
+    }
+    return *this;
+}
+
+inline CompactString::~CompactString()
+{
+    release();
+}
+
+inline void CompactString::release() noexcept
+{
+    if (!isInline() && heap()->ref.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        heap()->~Header();
+        ::operator delete(heap());
+    }
+}
+
+inline size_t CompactString::heapSize() const noexcept
+{
+    return isInline() ? 0 : sizeof(Header) + size();
+}
+
+inline bool CompactString::equals(const CompactString &other) const noexcept
+{
+    return m_size == other.m_size && std::memcmp(data(), other.data(), size()) == 0;
+}
+
+inline bool operator==(const CompactString &lhs, const CompactString &rhs) noexcept
+{
+    return lhs.equals(rhs);
+}
+
+inline bool operator!=(const CompactString &lhs, const CompactString &rhs) noexcept
+{
+    return !lhs.equals(rhs);
+}
+
+inline bool operator==(const CompactString &lhs, const QString &rhs) noexcept
+{
+    return lhs.equals(rhs);
+}
+
+inline bool operator!=(const CompactString &lhs, const QString &rhs) noexcept
+{
+    return !lhs.equals(rhs);
+}
+
+inline bool operator==(const QString &lhs, const CompactString &rhs) noexcept
+{
+    return rhs.equals(lhs);
+}
+
+inline bool operator!=(const QString &lhs, const CompactString &rhs) noexcept
+{
+    return !rhs.equals(lhs);
+}
+
+// Same order as QString, by UTF-16 code units. That is the byte order of UTF-8, except that
+// characters above U+FFFF, which UTF-16 stores as surrogates, sort before U+E000 to U+FFFF.
+inline bool operator<(const CompactString &lhs, const CompactString &rhs) noexcept
+{
+    const auto size = std::min(lhs.size(), rhs.size());
+    const auto *l = reinterpret_cast<const unsigned char *>(lhs.data());
+    const auto *r = reinterpret_cast<const unsigned char *>(rhs.data());
+    const auto mismatch = std::mismatch(l, l + size, r);
+    if (mismatch.first == l + size)
+        return lhs.size() < rhs.size();
+    // the strings have the same characters up to here, so both bytes start a character or
+    // both continue one; lead bytes 0xee and 0xef encode U+E000 to U+FFFF
+    const auto order = [](unsigned char byte) {
+        return byte == 0xee || byte == 0xef ? unsigned(byte) + 0x10 : unsigned(byte);
+    };
+    return order(*mismatch.first) < order(*mismatch.second);
+}
+
+inline const QString &toQString(const QString &s) noexcept { return s; }
+inline QString toQString(const CompactString &s) { return s.toQString(); }
@@ -0,0 +1,144 @@
+#include "concurrentobject.h"
+
+#include <utility>
+
+ConcurrentObject::ConcurrentObject(size_t shardCount)
+{
+    size_t count = 1;
+    while (count < shardCount)
+        count *= 2;
+    m_shards = std::make_unique<Shard[]>(count);
+    m_mask = count - 1;
+}
+
+ConcurrentObject::~ConcurrentObject() = default;
+
+size_t ConcurrentObject::size() const
+{
+    size_t result = 0;
+    for (size_t i = 0; i <= m_mask; ++i) {
+        std::shared_lock lock(m_shards[i].mutex);
+        result += m_shards[i].object.size();
+    }
+    return result;
+}
+
+bool ConcurrentObject::contains(const Key &key) const
+{
+    const size_t hash = hashOf(key);
+    const auto &shard = shardFor(hash);
+    std::shared_lock lock(shard.mutex);
+    const auto &map = shard.object.data();
+    return findIn(map, key, hash) != map.end();
+}
+
+std::optional<Value> ConcurrentObject::find(const Key &key) const
+{
+    const size_t hash = hashOf(key);
+    const auto &shard = shardFor(hash);
+    std::shared_lock lock(shard.mutex);
+    const auto &map = shard.object.data();
+    const auto it = findIn(map, key, hash);
+    if (it == map.end())
+        return std::nullopt;
+    return it->second;
+}
+
+bool ConcurrentObject::insert(std::pair<Key, Value> entry)
+{
+    const size_t hash = hashOf(entry.first);
+    auto &shard = shardFor(hash);
+    std::unique_lock lock(shard.mutex);
+    return insertIn(shard.object.data(), std::move(entry), hash).second;
+}
+
+bool ConcurrentObject::insert_or_assign(const Key &key, Value value)
+{
+    const size_t hash = hashOf(key);
+    auto &shard = shardFor(hash);
+    std::unique_lock lock(shard.mutex);
+    const auto [it, inserted] = insertIn(shard.object.data(), {key, Value()}, hash);
+    std::swap(it->second, value);
+    lock.unlock();
+    // the previous value, now in value, is destroyed without holding the lock
+    return inserted;
+}
+
+size_t ConcurrentObject::erase(const Key &key)
+{
+    const size_t hash = hashOf(key);
+    auto &shard = shardFor(hash);
+    std::unique_lock lock(shard.mutex);
+    const auto &constMap = std::as_const(shard.object).data();
+    if (findIn(constMap, key, hash) == constMap.end())
+        return 0;
+    // detaches the shard from snapshots before looking up the iterator
+    auto &data = shard.object.data();
+    const auto it = findIn(data, key, hash);
+    // destroyed without holding the lock
+    const Value erased = std::move(it->second);
+    data.erase(it);
+    lock.unlock();
+    return 1;
+}
+
+void ConcurrentObject::clear()
+{
+    for (size_t i = 0; i <= m_mask; ++i) {
+        Object erased;
+        std::unique_lock lock(m_shards[i].mutex);
+        std::swap(erased, m_shards[i].object);
+    }
+}
+
+auto ConcurrentObject::snapshot() const -> Snapshot
+{
+    // shards are locked in order, other operations hold a single lock, so this cannot deadlock
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    locks.reserve(m_mask + 1);
+    std::vector<Object> shards;
+    shards.reserve(m_mask + 1);
+    for (size_t i = 0; i <= m_mask; ++i) {
+        locks.emplace_back(m_shards[i].mutex);
+        shards.push_back(m_shards[i].object);
+    }
+    return Snapshot(std::move(shards));
+}
+
+size_t ConcurrentObject::shardIndex(size_t hash, size_t mask) noexcept
+{
+    // Fibonacci hashing takes the high bits, the Object in the shard uses the low ones
+    return size_t((uint64_t(hash) * 0x9e3779b97f4a7c15ull) >> 32) & mask;
+}
+
+size_t ConcurrentObject::Snapshot::size() const noexcept
+{
+    size_t result = 0;
+    for (const auto &shard: m_shards)
+        result += shard.size();
+    return result;
+}
+
+bool ConcurrentObject::Snapshot::contains(const Key &key) const noexcept
+{
+    return find(key);
+}
+
+const Value *ConcurrentObject::Snapshot::find(const Key &key) const
+{
+    const size_t hash = hashOf(key);
+    const auto &map = m_shards[shardIndex(hash, m_shards.size() - 1)].data();
+    const auto it = findIn(map, key, hash);
+    return it == map.end() ? nullptr : &it->second;
+}
+
+Object ConcurrentObject::Snapshot::toObject() const
+{
+    Object result;
+    result.reserve(size());
+    for (const auto &shard: m_shards) {
+        for (const auto &entry: shard)
+            result.insert(entry);
+    }
+    return result;
+}
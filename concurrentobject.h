@@ -0,0 +1,259 @@
+#pragma once
+
+#include "variant.h"
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <vector>
+
+// Object shared between threads, for caches written by several workers. Keys are spread over
+// shards by hash, each shard being an Object behind its own reader-writer lock, so threads
+// working on different keys rarely wait for each other.
+//
+// Lookups return copies, as references could be invalidated by other threads at any time.
+// Copies of strings and containers only share their data, so this is cheap.
+class ConcurrentObject
+{
+public:
+    using Key = ObjectKey;
+    class Snapshot;
+
+    static constexpr size_t DefaultShardCount = 64;
+
+    // The shard count is rounded up to a power of two
+    explicit ConcurrentObject(size_t shardCount = DefaultShardCount);
+    ConcurrentObject(const ConcurrentObject &) = delete;
+    ConcurrentObject &operator=(const ConcurrentObject &) = delete;
+    ~ConcurrentObject();
+
+    size_t shardCount() const noexcept { return m_mask + 1; }
+    // Sum of the shard sizes, other threads may change it meanwhile
+    size_t size() const;
+    bool isEmpty() const { return size() == 0; }
+
+    bool contains(const Key &key) const;
+    std::optional<Value> find(const Key &key) const;
+    template<typename T = Value>
+    T value(const Key &key, T defaultValue = {}) const;
+
+    // Like Object::insert, keeps the existing value. Returns true if the key was inserted.
+    bool insert(std::pair<Key, Value> entry);
+    // Returns true if the key was inserted, false if its value was replaced
+    bool insert_or_assign(const Key &key, Value value);
+    size_t erase(const Key &key);
+    void clear();
+
+    // Atomically updates the value of key: function is called with the current value, empty
+    // if there is none, while the shard is locked. Setting it stores it, resetting it erases
+    // the key. Returns the new value. If function throws, the key is erased: the value was
+    // moved into function's argument, so that updating a container does not copy it, and may
+    // be left half modified.
+    template<typename Function>
+    std::optional<Value> compute(const Key &key, Function function);
+
+    // Consistent copy of all entries, taken with all shards locked. Copying a shard only shares
+    // its data, a shard written later is then copied by the writer.
+    Snapshot snapshot() const;
+
+private:
+    // one per cache line, so that locking one shard does not slow down its neighbors
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex mutex;
+        Object object;
+    };
+
+    // The Object of a shard hashes keys the same way, lookups in it reuse the hash
+    static size_t hashOf(const Key &key) noexcept { return StringKeyHash()(key); }
+    static size_t shardIndex(size_t hash, size_t mask) noexcept;
+    static ObjectMap::const_iterator findIn(const ObjectMap &map, const Key &key, size_t hash);
+    static ObjectMap::iterator findIn(ObjectMap &map, const Key &key, size_t hash);
+    static std::pair<ObjectMap::iterator, bool> insertIn(ObjectMap &map,
+                                                         std::pair<Key, Value> entry,
+                                                         size_t hash);
+    Shard &shardFor(size_t hash) noexcept { return m_shards[shardIndex(hash, m_mask)]; }
+    const Shard &shardFor(size_t hash) const noexcept
+    {
+        return m_shards[shardIndex(hash, m_mask)];
+    }
+
+    std::unique_ptr<Shard[]> m_shards;
+    size_t m_mask;
+};
+
+// Entries of a ConcurrentObject at the time snapshot() was called, in no particular order
+class ConcurrentObject::Snapshot
+{
+public:
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = Object::const_iterator::difference_type;
+        using value_type = Object::const_iterator::value_type;
+        using reference = Object::const_iterator::reference;
+        using pointer = Object::const_iterator::pointer;
+
+        const_iterator() noexcept = default;
+
+        reference operator*() const noexcept { return *m_it; }
+        pointer operator->() const noexcept { return m_it.operator->(); }
+        const_iterator &operator++() noexcept
+        {
+            ++m_it;
+            skipEmptyShards();
+            return *this;
+        }
+        const_iterator operator++(int) noexcept
+        {
+            const_iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator==(const const_iterator &other) const noexcept
+        {
+            return m_shard == other.m_shard && (m_shard == endShard() || m_it == other.m_it);
+        }
+        bool operator!=(const const_iterator &other) const noexcept { return !(*this == other); }
+
+    private:
+        friend class Snapshot;
+
+        const_iterator(const std::vector<Object> *shards, size_t shard) noexcept
+            : m_shards(shards)
+            , m_shard(shard)
+        {
+            if (m_shard < endShard()) {
+                m_it = (*m_shards)[m_shard].begin();
+                skipEmptyShards();
+            }
+        }
+
+        size_t endShard() const noexcept { return m_shards ? m_shards->size() : 0; }
+
+        void skipEmptyShards() noexcept
+        {
+            while (m_shard < endShard() && m_it == (*m_shards)[m_shard].end()) {
+                if (++m_shard < endShard())
+                    m_it = (*m_shards)[m_shard].begin();
+            }
+        }
+
+        const std::vector<Object> *m_shards{nullptr};
+        size_t m_shard{0};
+        Object::const_iterator m_it;
+    };
+
+    const_iterator begin() const noexcept { return const_iterator(&m_shards, 0); }
+    const_iterator end() const noexcept { return const_iterator(&m_shards, m_shards.size()); }
+
+    size_t size() const noexcept;
+    bool isEmpty() const noexcept { return size() == 0; }
+    bool contains(const Key &key) const noexcept;
+    template<typename T = Value>
+    T value(const Key &key, T defaultValue = {}) const;
+
+    // Merges the shards into one Object
+    Object toObject() const;
+
+private:
+    friend class ConcurrentObject;
+
+    explicit Snapshot(std::vector<Object> shards) : m_shards(std::move(shards)) {}
+
+    // null if there is no such key
+    const Value *find(const Key &key) const;
+
+    // in the order of the shards they were copied from
+    std::vector<Object> m_shards;
+};
+
+inline ObjectMap::const_iterator ConcurrentObject::findIn(const ObjectMap &map, const Key &key,
+                                                          size_t hash)
+{
+#if defined(RECURSIVEVARIANT_UNORDERED_OBJECTS)
+    Q_UNUSED(hash);
+    return map.find(key);
+#else
+    return map.findHashed(key, hash);
+#endif
+}
+
+inline ObjectMap::iterator ConcurrentObject::findIn(ObjectMap &map, const Key &key, size_t hash)
+{
+#if defined(RECURSIVEVARIANT_UNORDERED_OBJECTS)
+    Q_UNUSED(hash);
+    return map.find(key);
+#else
+    return map.findHashed(key, hash);
+#endif
+}
+
+inline std::pair<ObjectMap::iterator, bool> ConcurrentObject::insertIn(ObjectMap &map,
+                                                                       std::pair<Key, Value> entry,
+                                                                       size_t hash)
+{
+#if defined(RECURSIVEVARIANT_UNORDERED_OBJECTS)
+    Q_UNUSED(hash);
+    return map.insert(std::move(entry));
+#else
+    return map.insertHashed(std::move(entry), hash);
+#endif
+}
+
+template<typename T>
+inline T ConcurrentObject::value(const Key &key, T defaultValue) const
+{
+    const size_t hash = hashOf(key);
+    const auto &shard = shardFor(hash);
+    std::shared_lock lock(shard.mutex);
+    const auto &map = shard.object.data();
+    const auto it = findIn(map, key, hash);
+    if (it == map.end())
+        return defaultValue;
+    if constexpr (std::is_same_v<T, Value>)
+        return it->second;
+    else
+        return it->second.template value<T>(std::move(defaultValue));
+}
+
+template<typename T>
+inline T ConcurrentObject::Snapshot::value(const Key &key, T defaultValue) const
+{
+    const Value *found = find(key);
+    if (!found)
+        return defaultValue;
+    if constexpr (std::is_same_v<T, Value>)
+        return *found;
+    else
+        return found->template value<T>(std::move(defaultValue));
+}
+
+template<typename Function>
+inline std::optional<Value> ConcurrentObject::compute(const Key &key, Function function)
+{
+    const size_t hash = hashOf(key);
+    auto &shard = shardFor(hash);
+    std::unique_lock lock(shard.mutex);
+    auto &map = shard.object.data();
+    // a single lookup, a new key is inserted with a placeholder
+    const auto [it, inserted] = insertIn(map, {key, Value()}, hash);
+    std::optional<Value> value;
+    if (!inserted)
+        value = std::move(it->second);
+    try {
+        function(value);
+    } catch (...) {
+        map.erase(it);
+        throw;
+    }
+    if (!value) {
+        map.erase(it);
+        return value;
+    }
+    it->second = *value;
+    return value;
+}
@@ -0,0 +1,52 @@
+#include "constvalue.h"
+
+namespace {
+
+QString fromLiteral(std::u16string_view string)
+{
+    return QString::fromRawData(reinterpret_cast<const QChar *>(string.data()),
+                                qsizetype(string.size()));
+}
+
+} // namespace
+
+QString ValueView::toString() const
+{
+    return fromLiteral(toStringView());
+}
+
+Value ValueView::toValue() const
+{
+    switch (type()) {
+    case Value::Type::Bool:
+        return m_value->m_bool;
+    case Value::Type::Int:
+        return m_value->m_int32;
+    case Value::Type::UInt:
+        return m_value->m_uint32;
+    case Value::Type::Int64:
+        return m_value->m_int64;
+    case Value::Type::UInt64:
+        return m_value->m_uint64;
+    case Value::Type::Double:
+        return m_value->m_double;
+    case Value::Type::String:
+        return toString();
+    case Value::Type::Array: {
+        Array result;
+        result.reserve(size());
+        for (size_t i = 0; i < size(); ++i)
+            result.append(at(i).toValue());
+        return result;
+    }
+    case Value::Type::Object: {
+        Object result;
+        result.reserve(size());
+        for (size_t i = 0; i < size(); ++i)
+            result.insert({fromLiteral(key(i)), at(i).toValue()});
+        return result;
+    }
+    default:
+        return {};
+    }
+}
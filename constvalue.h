@@ -0,0 +1,224 @@
+#pragma once
+
+#include "variant.h"
+
+#include <cstdint>
+#include <string_view>
+
+struct ConstEntry;
+
+// Immutable value built at compile time, for large static defaults. A constexpr ConstValue
+// needs no dynamic initialization and lives in read-only data. Strings are UTF-16 literals
+// (u"..."), containers refer to constexpr arrays defined beforehand:
+//
+//     constexpr ConstValue defines[] = {u"NDEBUG", u"QT_NO_CAST_FROM_ASCII"};
+//     constexpr ConstEntry options[] = {{u"optimize", true}, {u"defines", defines}};
+//     constexpr ConstValue defaults = options;
+//
+// Read it through ValueView, or promote it to a Value with ValueView::toValue().
+class ConstValue
+{
+public:
+    constexpr ConstValue() noexcept : m_type(Value::Type::Null), m_int64(0) {}
+    constexpr ConstValue(bool value) noexcept : m_type(Value::Type::Bool), m_bool(value) {}
+    constexpr ConstValue(int32_t value) noexcept : m_type(Value::Type::Int), m_int32(value) {}
+    constexpr ConstValue(uint32_t value) noexcept : m_type(Value::Type::UInt), m_uint32(value) {}
+    constexpr ConstValue(int64_t value) noexcept : m_type(Value::Type::Int64), m_int64(value) {}
+    constexpr ConstValue(uint64_t value) noexcept : m_type(Value::Type::UInt64), m_uint64(value) {}
+    constexpr ConstValue(double value) noexcept : m_type(Value::Type::Double), m_double(value) {}
+
+    template<size_t N>
+    constexpr ConstValue(const char16_t (&string)[N]) noexcept
+        : m_type(Value::Type::String)
+        , m_string(string)
+        , m_size(N - 1)
+    {
+    }
+
+    template<size_t N>
+    constexpr ConstValue(const ConstValue (&items)[N]) noexcept
+        : m_type(Value::Type::Array)
+        , m_items(items)
+        , m_size(N)
+    {
+    }
+
+    template<size_t N>
+    constexpr ConstValue(const ConstEntry (&entries)[N]) noexcept
+        : m_type(Value::Type::Object)
+        , m_entries(entries)
+        , m_size(N)
+    {
+    }
+
+    // Arrays of size 0 are not allowed, so empty containers have their own factories
+    static constexpr ConstValue emptyArray() noexcept
+    {
+        return ConstValue(Value::Type::Array, static_cast<const ConstValue *>(nullptr));
+    }
+
+    static constexpr ConstValue emptyObject() noexcept
+    {
+        return ConstValue(Value::Type::Object, static_cast<const ConstEntry *>(nullptr));
+    }
+
+private:
+    friend class ValueView;
+
+    constexpr ConstValue(Value::Type type, const ConstValue *items) noexcept
+        : m_type(type)
+        , m_items(items)
+    {
+    }
+
+    constexpr ConstValue(Value::Type type, const ConstEntry *entries) noexcept
+        : m_type(type)
+        , m_entries(entries)
+    {
+    }
+
+    Value::Type m_type;
+    union {
+        bool m_bool;
+        int32_t m_int32;
+        uint32_t m_uint32;
+        int64_t m_int64;
+        uint64_t m_uint64;
+        double m_double;
+        const char16_t *m_string;
+        const ConstValue *m_items;
+        const ConstEntry *m_entries;
+    };
+    // string length or number of items or entries
+    size_t m_size{0};
+};
+
+struct ConstEntry
+{
+    std::u16string_view key;
+    ConstValue value;
+};
+
+// Read-only accessor for a ConstValue. Lookups that do not match the type or miss return a
+// null view, so they can be chained. Everything but the conversions to Qt types is constexpr.
+class ValueView
+{
+public:
+    constexpr ValueView() noexcept = default;
+    constexpr ValueView(const ConstValue &value) noexcept : m_value(&value) {}
+
+    constexpr Value::Type type() const noexcept
+    {
+        return m_value ? m_value->m_type : Value::Type::Null;
+    }
+    constexpr bool isNull() const noexcept { return type() == Value::Type::Null; }
+
+    constexpr bool toBool(bool defaultValue = false) const noexcept
+    {
+        return type() == Value::Type::Bool ? m_value->m_bool : defaultValue;
+    }
+
+    // Accepts any of the integer types whose value fits
+    constexpr int64_t toInt64(int64_t defaultValue = 0) const noexcept
+    {
+        switch (type()) {
+        case Value::Type::Int:
+            return m_value->m_int32;
+        case Value::Type::UInt:
+            return m_value->m_uint32;
+        case Value::Type::Int64:
+            return m_value->m_int64;
+        case Value::Type::UInt64:
+            return m_value->m_uint64 <= uint64_t(INT64_MAX) ? int64_t(m_value->m_uint64)
+                                                            : defaultValue;
+        default:
+            return defaultValue;
+        }
+    }
+
+    // Accepts integers as well
+    constexpr double toDouble(double defaultValue = 0) const noexcept
+    {
+        switch (type()) {
+        case Value::Type::Double:
+            return m_value->m_double;
+        case Value::Type::UInt64:
+            return double(m_value->m_uint64);
+        case Value::Type::Int:
+        case Value::Type::UInt:
+        case Value::Type::Int64:
+            return double(toInt64());
+        default:
+            return defaultValue;
+        }
+    }
+
+    constexpr std::u16string_view toStringView() const noexcept
+    {
+        if (type() != Value::Type::String)
+            return {};
+        return {m_value->m_string, m_value->m_size};
+    }
+
+    // Refers to the literal without copying it
+    QString toString() const;
+
+    // Number of items or entries, 0 for other types
+    constexpr size_t size() const noexcept
+    {
+        return type() == Value::Type::Array || type() == Value::Type::Object ? m_value->m_size
+                                                                             : 0;
+    }
+    constexpr bool isEmpty() const noexcept { return size() == 0; }
+
+    // Item of an array or value of the entry at index of an object
+    constexpr ValueView at(size_t index) const noexcept
+    {
+        if (index >= size())
+            return {};
+        if (type() == Value::Type::Array)
+            return m_value->m_items[index];
+        return m_value->m_entries[index].value;
+    }
+
+    // Key of the entry at index of an object
+    constexpr std::u16string_view key(size_t index) const noexcept
+    {
+        if (type() != Value::Type::Object || index >= size())
+            return {};
+        return m_value->m_entries[index].key;
+    }
+
+    constexpr ValueView operator[](size_t index) const noexcept
+    {
+        return type() == Value::Type::Array ? at(index) : ValueView();
+    }
+
+    // Linear search, the first entry with the key wins
+    constexpr ValueView operator[](std::u16string_view key) const noexcept
+    {
+        if (type() != Value::Type::Object)
+            return {};
+        for (size_t i = 0; i < m_value->m_size; ++i) {
+            if (m_value->m_entries[i].key == key)
+                return m_value->m_entries[i].value;
+        }
+        return {};
+    }
+
+    constexpr bool contains(std::u16string_view key) const noexcept
+    {
+        for (size_t i = 0; i < size() && type() == Value::Type::Object; ++i) {
+            if (m_value->m_entries[i].key == key)
+                return true;
+        }
+        return false;
+    }
+
+    // Builds the equivalent Value. Strings and QString keys refer to the literals, so mostly
+    // the containers allocate.
+    Value toValue() const;
+
+private:
+    const ConstValue *m_value{nullptr};
+};
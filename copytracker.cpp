@@ -0,0 +1,178 @@
+#include "copytracker.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+namespace {
+
+struct ThreadCounts
+{
+    size_t deepCopies{0};
+    size_t copiedElements{0};
+    size_t conversions{0};
+    CopySite lastSite;
+};
+
+thread_local ThreadCounts threadCounts;
+
+#if defined(RECURSIVEVARIANT_TRACK_COPIES)
+
+// File names of inline functions may be distinct literals in each translation unit, so sites
+// are compared by content
+using SiteKey = std::tuple<std::string_view, int, std::string_view>;
+
+struct Registry
+{
+    std::mutex mutex;
+    std::map<SiteKey, CopyTracker::Site> sites;
+};
+
+void printReport()
+{
+    const auto report = CopyTracker::report();
+    if (!report.isEmpty())
+        std::fputs(report.toUtf8().constData(), stderr);
+}
+
+// Never destroyed, containers may still be modified by destructors running after exit
+Registry &registry()
+{
+    static Registry *instance = [] {
+        std::atexit(printReport);
+        return new Registry;
+    }();
+    return *instance;
+}
+
+#endif
+
+} // namespace
+
+void CopyTracker::record(Event event, size_t size, const CopySite &site)
+{
+    auto &counts = threadCounts;
+    const bool isCopy = event == Event::ArrayCopy || event == Event::ObjectCopy;
+    if (isCopy) {
+        ++counts.deepCopies;
+        counts.copiedElements += size;
+    } else {
+        ++counts.conversions;
+    }
+    counts.lastSite = site;
+
+#if defined(RECURSIVEVARIANT_TRACK_COPIES)
+    auto &instance = registry();
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    auto &entry = instance.sites[{site.file(), site.line(), site.function()}];
+    entry.file = site.file();
+    entry.line = site.line();
+    entry.function = site.function();
+    switch (event) {
+    case Event::ArrayCopy:
+        ++entry.arrayCopies;
+        break;
+    case Event::ObjectCopy:
+        ++entry.objectCopies;
+        break;
+    case Event::ToQVariant:
+    case Event::FromQVariant:
+        ++entry.conversions;
+        break;
+    }
+    if (isCopy)
+        entry.copiedElements += size;
+#endif
+}
+
+std::vector<CopyTracker::Site> CopyTracker::sites()
+{
+    std::vector<Site> result;
+#if defined(RECURSIVEVARIANT_TRACK_COPIES)
+    {
+        auto &instance = registry();
+        std::lock_guard<std::mutex> lock(instance.mutex);
+        result.reserve(instance.sites.size());
+        for (const auto &entry: instance.sites)
+            result.push_back(entry.second);
+    }
+    std::stable_sort(result.begin(), result.end(), [](const Site &lhs, const Site &rhs) {
+        return std::make_tuple(lhs.copiedElements, lhs.deepCopies(), lhs.conversions)
+                > std::make_tuple(rhs.copiedElements, rhs.deepCopies(), rhs.conversions);
+    });
+#endif
+    return result;
+}
+
+QString CopyTracker::report()
+{
+    const auto all = sites();
+    if (all.empty())
+        return {};
+    std::string result = "Deep copies and QVariant conversions by call site:\n"
+                         "  arrays objects   elements conversions site\n";
+    char line[64];
+    for (const auto &site: all) {
+        std::snprintf(line, sizeof(line), "%8zu%8zu%11zu%12zu ", site.arrayCopies,
+                      site.objectCopies, site.copiedElements, site.conversions);
+        result += line;
+        result += site.file;
+        result += ':' + std::to_string(site.line) + " (" + site.function + ")\n";
+    }
+    return QString::fromUtf8(result.data(), qsizetype(result.size()));
+}
+
+void CopyTracker::reset()
+{
+#if defined(RECURSIVEVARIANT_TRACK_COPIES)
+    auto &instance = registry();
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    instance.sites.clear();
+#endif
+}
+
+CopyCounter::CopyCounter() noexcept
+    : m_deepCopies(threadCounts.deepCopies)
+    , m_copiedElements(threadCounts.copiedElements)
+    , m_conversions(threadCounts.conversions)
+{
+}
+
+size_t CopyCounter::deepCopies() const noexcept
+{
+    return threadCounts.deepCopies - m_deepCopies;
+}
+
+size_t CopyCounter::copiedElements() const noexcept
+{
+    return threadCounts.copiedElements - m_copiedElements;
+}
+
+size_t CopyCounter::conversions() const noexcept
+{
+    return threadCounts.conversions - m_conversions;
+}
+
+CopySite CopyCounter::lastSite() const noexcept
+{
+    return deepCopies() || conversions() ? threadCounts.lastSite : CopySite();
+}
+
+QString CopyCounter::toString() const
+{
+    const auto site = lastSite();
+    std::string result = std::to_string(deepCopies()) + " deep copies of "
+            + std::to_string(copiedElements()) + " elements, " + std::to_string(conversions())
+            + " QVariant conversions";
+    if (site.line()) {
+        result += ", last at ";
+        result += site.file();
+        result += ':' + std::to_string(site.line()) + " (" + site.function() + ')';
+    }
+    return QString::fromUtf8(result.data(), qsizetype(result.size()));
+}
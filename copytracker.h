@@ -0,0 +1,136 @@
+#pragma once
+
+#include <QtCore/QString>
+
+#include <cstddef>
+#include <vector>
+
+// Build with RECURSIVEVARIANT_TRACK_COPIES defined to count, per call site, the deep copies of
+// Array and Object data and the conversions to and from QVariant. Copying a container only
+// shares its data, the deep copy happens when a shared container is modified, so the site
+// reported is the modifying call, such as append() or insert(), not the copy that shared it.
+//
+// In such builds, functions that may deep-copy take a CopySite as last argument, defaulted to
+// their caller's location; other builds keep their plain signatures. Operators cannot take
+// one, so copies made by operator[] are reported at operator[] itself: data()[index] reports
+// the caller instead, and a CopyCounter around the code narrows them down.
+class CopySite
+{
+public:
+#if defined(RECURSIVEVARIANT_TRACK_COPIES)
+    static constexpr CopySite current(const char *file = __builtin_FILE(),
+                                      int line = __builtin_LINE(),
+                                      const char *function = __builtin_FUNCTION()) noexcept
+    {
+        return CopySite(file, line, function);
+    }
+
+    constexpr CopySite() noexcept = default;
+    constexpr CopySite(const char *file, int line, const char *function) noexcept
+        : m_file(file)
+        , m_line(line)
+        , m_function(function)
+    {}
+
+    constexpr const char *file() const noexcept { return m_file; }
+    constexpr int line() const noexcept { return m_line; }
+    constexpr const char *function() const noexcept { return m_function; }
+
+private:
+    const char *m_file{""};
+    int m_line{0};
+    const char *m_function{""};
+#else
+    // empty, so that passing it costs nothing
+    static constexpr CopySite current() noexcept { return CopySite(); }
+
+    constexpr const char *file() const noexcept { return ""; }
+    constexpr int line() const noexcept { return 0; }
+    constexpr const char *function() const noexcept { return ""; }
+#endif
+};
+
+// The CopySite parameter of the functions that may deep-copy, alone or after others, with
+// its default in declarations and without in definitions, and the argument passing it on.
+// Empty unless tracking copies.
+#if defined(RECURSIVEVARIANT_TRACK_COPIES)
+#define RECURSIVEVARIANT_COPY_SITE CopySite site = CopySite::current()
+#define RECURSIVEVARIANT_AND_COPY_SITE , CopySite site = CopySite::current()
+#define RECURSIVEVARIANT_COPY_SITE_DEFINITION CopySite site
+#define RECURSIVEVARIANT_AND_COPY_SITE_DEFINITION , CopySite site
+#define RECURSIVEVARIANT_COPY_SITE_ARGUMENT site
+#else
+#define RECURSIVEVARIANT_COPY_SITE
+#define RECURSIVEVARIANT_AND_COPY_SITE
+#define RECURSIVEVARIANT_COPY_SITE_DEFINITION
+#define RECURSIVEVARIANT_AND_COPY_SITE_DEFINITION
+#define RECURSIVEVARIANT_COPY_SITE_ARGUMENT
+#endif
+
+// Process-wide statistics of the tracked copies, empty unless built with
+// RECURSIVEVARIANT_TRACK_COPIES. Such builds print report() to stderr at exit if anything was
+// recorded.
+class CopyTracker
+{
+public:
+    enum class Event {
+        ArrayCopy,
+        ObjectCopy,
+        ToQVariant,
+        FromQVariant
+    };
+
+    struct Site
+    {
+        const char *file{""};
+        int line{0};
+        const char *function{""};
+        size_t arrayCopies{0};
+        size_t objectCopies{0};
+        // elements of the copied arrays and entries of the copied objects
+        size_t copiedElements{0};
+        size_t conversions{0};
+
+        size_t deepCopies() const noexcept { return arrayCopies + objectCopies; }
+    };
+
+    static constexpr bool isEnabled() noexcept
+    {
+#if defined(RECURSIVEVARIANT_TRACK_COPIES)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Called by the containers, size is the number of elements copied. Thread-safe.
+    static void record(Event event, size_t size, const CopySite &site);
+
+    // Sites sorted by copied elements, then by deep copies and conversions
+    static std::vector<Site> sites();
+    // One line per site, in the order of sites(); empty if nothing was recorded
+    static QString report();
+    static void reset();
+};
+
+// Counts the deep copies and conversions made by the current thread during its lifetime, for
+// tests asserting that some code does not copy. Always counts 0 unless built with
+// RECURSIVEVARIANT_TRACK_COPIES.
+class CopyCounter
+{
+public:
+    CopyCounter() noexcept;
+
+    size_t deepCopies() const noexcept;
+    size_t copiedElements() const noexcept;
+    size_t conversions() const noexcept;
+    // Location of the last deep copy or conversion counted, if any
+    CopySite lastSite() const noexcept;
+    // Summary of the counts and of the last site, for failure messages
+    QString toString() const;
+
+private:
+    size_t m_deepCopies;
+    size_t m_copiedElements;
+    size_t m_conversions;
+};
@@ -0,0 +1,551 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Hash map that keeps its entries in insertion order, so iteration order is reproducible.
+// Entries live in chunks that never move, like the nodes of std::unordered_map, and the order
+// is a dense vector of pointers to them, so iteration is a linear scan. Lookups go through a
+// separate open addressing index of positions in the order; small maps have no index and are
+// searched linearly. Erased entries leave a null tombstone in the order, compacted away once
+// tombstones make up half of it, and their storage is reused by later insertions.
+//
+// Provides the subset of the std::unordered_map API used by Object. As with it, references
+// to elements stay valid until the element is erased. Insertion invalidates iterators,
+// erase() invalidates iterators to other elements when it compacts.
+// Keys must not be modified through iterators.
+template<typename Key, typename T, typename Hash = std::hash<Key>,
+         typename KeyEqual = std::equal_to<Key>>
+class OrderedHashMap
+{
+    template<bool Const>
+    class Iterator;
+
+    // Keys of other types than Key can be looked up if Hash and KeyEqual are transparent
+    template<typename Functor, typename = void>
+    struct IsTransparent : std::false_type {};
+    template<typename Functor>
+    struct IsTransparent<Functor, std::void_t<typename Functor::is_transparent>>
+        : std::true_type {};
+    template<typename K>
+    using EnableIfTransparent = std::enable_if_t<
+            !std::is_same_v<K, Key> && IsTransparent<Hash>::value
+            && IsTransparent<KeyEqual>::value && std::is_invocable_v<const Hash &, const K &>
+            && std::is_invocable_v<const KeyEqual &, const Key &, const K &>>;
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using size_type = size_t;
+    using difference_type = std::ptrdiff_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    OrderedHashMap() = default;
+    OrderedHashMap(std::initializer_list<value_type> list);
+    OrderedHashMap(const OrderedHashMap &other);
+    OrderedHashMap(OrderedHashMap &&other) noexcept { swap(other); }
+    OrderedHashMap &operator=(const OrderedHashMap &other);
+    OrderedHashMap &operator=(OrderedHashMap &&other) noexcept;
+    ~OrderedHashMap() = default;
+
+    iterator begin() noexcept { return {m_order.data(), orderEnd()}; }
+    const_iterator begin() const noexcept { return {m_order.data(), orderEnd()}; }
+    const_iterator cbegin() const noexcept { return begin(); }
+    iterator end() noexcept { return {orderEnd(), orderEnd()}; }
+    const_iterator end() const noexcept { return {orderEnd(), orderEnd()}; }
+    const_iterator cend() const noexcept { return end(); }
+
+    bool empty() const noexcept { return m_size == 0; }
+    size_t size() const noexcept { return m_size; }
+    void reserve(size_t size);
+    void clear() noexcept;
+    void swap(OrderedHashMap &other) noexcept;
+
+    iterator find(const Key &key) noexcept;
+    const_iterator find(const Key &key) const noexcept;
+    // Checks the element at position hint in the insertion order first, and sets hint to the
+    // position of the element found, for callers looking up the same key in similar maps
+    const_iterator find(const Key &key, size_t &hint) const noexcept;
+    size_t count(const Key &key) const noexcept { return findEntry(key) != npos ? 1 : 0; }
+    // Heterogeneous lookup; K must hash and compare like the Key it equals
+    template<typename K, typename = EnableIfTransparent<K>>
+    iterator find(const K &key) noexcept;
+    template<typename K, typename = EnableIfTransparent<K>>
+    const_iterator find(const K &key) const noexcept;
+    template<typename K, typename = EnableIfTransparent<K>>
+    size_t count(const K &key) const noexcept { return findEntry(key) != npos ? 1 : 0; }
+    T &at(const Key &key);
+    const T &at(const Key &key) const;
+    T &operator[](const Key &key);
+
+    std::pair<iterator, bool> insert(value_type value);
+    // Same as find() and insert(), for callers that already computed hash = Hash()(key)
+    iterator findHashed(const Key &key, size_t hash) noexcept;
+    const_iterator findHashed(const Key &key, size_t hash) const noexcept;
+    std::pair<iterator, bool> insertHashed(value_type value, size_t hash);
+    iterator erase(const_iterator it);
+    size_t erase(const Key &key);
+
+private:
+    static constexpr size_t npos = size_t(-1);
+    static constexpr uint32_t EmptyBucket = uint32_t(-1);
+    // Maps up to this size have no index
+    static constexpr size_t IndexThreshold = 8;
+    // Entries allocated at once when the map grows without reserve()
+    static constexpr size_t MinChunkSize = 4;
+
+    struct Bucket
+    {
+        // position in m_order
+        uint32_t entry{EmptyBucket};
+        // low bits of the key hash, so the index can grow without rehashing keys
+        uint32_t hash{0};
+    };
+
+    value_type **orderEnd() noexcept { return m_order.data() + m_order.size(); }
+    value_type *const *orderEnd() const noexcept { return m_order.data() + m_order.size(); }
+
+    template<typename K>
+    static uint32_t hashOf(const K &key) noexcept { return uint32_t(Hash()(key)); }
+    template<typename K>
+    size_t findEntry(const K &key) const noexcept;
+    template<typename K>
+    size_t findEntry(const K &key, uint32_t hash) const noexcept;
+    void addToIndex(uint32_t entry, uint32_t hash) noexcept;
+    void rebuildIndex(size_t capacity);
+    void compact();
+    // Makes sure count more entries can be stored without allocating
+    void reserveEntries(size_t count);
+    value_type *allocateEntry();
+
+    // storage of the entries, never moved
+    std::vector<std::unique_ptr<value_type[]>> m_chunks;
+    // unused entries at the end of the last chunk
+    value_type *m_chunkNext{nullptr};
+    value_type *m_chunkEnd{nullptr};
+    // entries freed by erase(), reset to value_type()
+    std::vector<value_type *> m_freeEntries;
+    // entries in insertion order, null for erased ones
+    std::vector<value_type *> m_order;
+    // power of two sized, at most half full; empty while the map is small
+    std::vector<Bucket> m_index;
+    size_t m_size{0};
+};
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+template<bool Const>
+class OrderedHashMap<Key, T, Hash, KeyEqual>::Iterator
+{
+    using Entry = typename OrderedHashMap::value_type;
+    using EntryPointer = std::conditional_t<Const, Entry *const *, Entry **>;
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename OrderedHashMap::value_type;
+    using reference = std::conditional_t<Const, const value_type &, value_type &>;
+    using pointer = std::conditional_t<Const, const value_type *, value_type *>;
+
+    inline Iterator() noexcept = default;
+    inline Iterator(EntryPointer entry, EntryPointer end) noexcept : p(entry), e(end) { skip(); }
+    template<bool C = Const, typename = std::enable_if_t<C>>
+    inline Iterator(const Iterator<false> &other) noexcept : p(other.p), e(other.e) {}
+
+    inline reference operator*() const noexcept { return **p; }
+    inline pointer operator->() const noexcept { return *p; }
+
+    // non-members, so an iterator converts when compared to a const_iterator
+    friend inline bool operator==(const Iterator &a, const Iterator &b) noexcept
+    { return a.p == b.p; }
+    friend inline bool operator!=(const Iterator &a, const Iterator &b) noexcept
+    { return a.p != b.p; }
+
+    inline Iterator &operator++() noexcept { ++p; skip(); return *this; }
+    inline Iterator operator++(int) noexcept { Iterator n = *this; ++*this; return n; }
+
+private:
+    friend class OrderedHashMap;
+    template<bool> friend class Iterator;
+
+    inline void skip() noexcept
+    {
+        while (p != e && !*p)
+            ++p;
+    }
+
+    EntryPointer p{nullptr};
+    EntryPointer e{nullptr};
+};
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+OrderedHashMap<Key, T, Hash, KeyEqual>::OrderedHashMap(std::initializer_list<value_type> list)
+{
+    reserve(list.size());
+    for (const auto &item: list)
+        insert(item);
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+OrderedHashMap<Key, T, Hash, KeyEqual>::OrderedHashMap(const OrderedHashMap &other)
+    : m_index(other.m_index)
+    , m_size(other.m_size)
+{
+    // tombstones are copied too, so the positions in the copied index stay valid
+    reserveEntries(m_size);
+    m_order.reserve(other.m_order.size());
+    for (const auto entry: other.m_order) {
+        value_type *copy = nullptr;
+        if (entry) {
+            copy = allocateEntry();
+            *copy = *entry;
+        }
+        m_order.push_back(copy);
+    }
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+auto OrderedHashMap<Key, T, Hash, KeyEqual>::operator=(const OrderedHashMap &other)
+    -> OrderedHashMap &
+{
+    if (this != &other)
+        *this = OrderedHashMap(other);
+    return *this;
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+auto OrderedHashMap<Key, T, Hash, KeyEqual>::operator=(OrderedHashMap &&other) noexcept
+    -> OrderedHashMap &
+{
+    OrderedHashMap(std::move(other)).swap(*this);
+    return *this;
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+void OrderedHashMap<Key, T, Hash, KeyEqual>::swap(OrderedHashMap &other) noexcept
+{
+    using std::swap;
+    swap(m_chunks, other.m_chunks);
+    swap(m_chunkNext, other.m_chunkNext);
+    swap(m_chunkEnd, other.m_chunkEnd);
+    swap(m_freeEntries, other.m_freeEntries);
+    swap(m_order, other.m_order);
+    swap(m_index, other.m_index);
+    swap(m_size, other.m_size);
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+void OrderedHashMap<Key, T, Hash, KeyEqual>::reserve(size_t size)
+{
+    m_order.reserve(size);
+    if (size > m_size)
+        reserveEntries(size - m_size);
+    if (size > IndexThreshold && m_index.size() < 2 * size)
+        rebuildIndex(2 * size);
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+void OrderedHashMap<Key, T, Hash, KeyEqual>::clear() noexcept
+{
+    m_chunks.clear();
+    m_chunkNext = nullptr;
+    m_chunkEnd = nullptr;
+    m_freeEntries.clear();
+    m_order.clear();
+    m_index.clear();
+    m_size = 0;
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+auto OrderedHashMap<Key, T, Hash, KeyEqual>::find(const Key &key) noexcept -> iterator
+{
+    const auto entry = findEntry(key);
+    return entry == npos ? end() : iterator(m_order.data() + entry, orderEnd());
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+auto OrderedHashMap<Key, T, Hash, KeyEqual>::find(const Key &key) const noexcept
+    -> const_iterator
+{
+    const auto entry = findEntry(key);
+    return entry == npos ? end() : const_iterator(m_order.data() + entry, orderEnd());
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+template<typename K, typename>
+auto OrderedHashMap<Key, T, Hash, KeyEqual>::find(const K &key) noexcept -> iterator
+{
+    const auto entry = findEntry(key);
+    return entry == npos ? end() : iterator(m_order.data() + entry, orderEnd());
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+template<typename K, typename>
+auto OrderedHashMap<Key, T, Hash, KeyEqual>::find(const K &key) const noexcept -> const_iterator
+{
+    const auto entry = findEntry(key);
+    return entry == npos ? end() : const_iterator(m_order.data() + entry, orderEnd());
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+auto OrderedHashMap<Key, T, Hash, KeyEqual>::find(const Key &key, size_t &hint) const noexcept
+    -> const_iterator
+{
+    if (hint < m_order.size() && m_order[hint] && KeyEqual()(m_order[hint]->first, key))
+        return const_iterator(m_order.data() + hint, orderEnd());
+    const auto entry = findEntry(key);
+    if (entry == npos)
+        return end();
+    hint = entry;
+    return const_iterator(m_order.data() + entry, orderEnd());
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+T &OrderedHashMap<Key, T, Hash, KeyEqual>::at(const Key &key)
+{
+    const auto entry = findEntry(key);
+    if (entry == npos)
+        throw std::out_of_range("OrderedHashMap::at: no such key");
+    return m_order[entry]->second;
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+const T &OrderedHashMap<Key, T, Hash, KeyEqual>::at(const Key &key) const
+{
+    const auto entry = findEntry(key);
+    if (entry == npos)
+        throw std::out_of_range("OrderedHashMap::at: no such key");
+    return m_order[entry]->second;
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+T &OrderedHashMap<Key, T, Hash, KeyEqual>::operator[](const Key &key)
+{
+    const auto entry = findEntry(key);
+    if (entry != npos)
+        return m_order[entry]->second;
+    return insert({key, T()}).first->second;
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+auto OrderedHashMap<Key, T, Hash, KeyEqual>::insert(value_type value)
+    -> std::pair<iterator, bool>
+{
+    // small maps without index do not need the hash
+    const bool indexed = !m_index.empty() || m_order.size() >= IndexThreshold;
+    const size_t hash = indexed ? Hash()(value.first) : 0;
+    return insertHashed(std::move(value), hash);
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+auto OrderedHashMap<Key, T, Hash, KeyEqual>::findHashed(const Key &key, size_t hash) noexcept
+    -> iterator
+{
+    const auto entry = findEntry(key, uint32_t(hash));
+    return entry == npos ? end() : iterator(m_order.data() + entry, orderEnd());
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+auto OrderedHashMap<Key, T, Hash, KeyEqual>::findHashed(const Key &key, size_t hash) const
+    noexcept -> const_iterator
+{
+    const auto entry = findEntry(key, uint32_t(hash));
+    return entry == npos ? end() : const_iterator(m_order.data() + entry, orderEnd());
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+auto OrderedHashMap<Key, T, Hash, KeyEqual>::insertHashed(value_type value, size_t fullHash)
+    -> std::pair<iterator, bool>
+{
+    const bool indexed = !m_index.empty() || m_order.size() >= IndexThreshold;
+    const auto hash = uint32_t(fullHash);
+    const auto existing = findEntry(value.first, hash);
+    if (existing != npos)
+        return {iterator(m_order.data() + existing, orderEnd()), false};
+
+    const auto entry = uint32_t(m_order.size());
+    if (indexed && (m_order.size() + 1) * 2 > m_index.size())
+        rebuildIndex((m_order.size() + 1) * 2);
+    m_order.push_back(nullptr);
+    try {
+        m_order.back() = allocateEntry();
+    } catch (...) {
+        m_order.pop_back();
+        throw;
+    }
+    *m_order.back() = std::move(value);
+    ++m_size;
+    if (indexed)
+        addToIndex(entry, hash);
+    return {iterator(m_order.data() + entry, orderEnd()), true};
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+auto OrderedHashMap<Key, T, Hash, KeyEqual>::erase(const_iterator it) -> iterator
+{
+    const auto entry = size_t(it.p - m_order.data());
+    auto &erased = m_order[entry];
+    // release the payload now, the tombstone only keeps its place in the order
+    *erased = value_type();
+    m_freeEntries.push_back(erased);
+    erased = nullptr;
+    --m_size;
+
+    if (2 * m_size >= m_order.size())
+        return iterator(m_order.data() + entry + 1, orderEnd());
+
+    // after compaction the next element moves to the number of live entries before it
+    size_t next = 0;
+    for (size_t i = 0; i < entry; ++i)
+        next += m_order[i] ? 1 : 0;
+    compact();
+    return iterator(m_order.data() + next, orderEnd());
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+size_t OrderedHashMap<Key, T, Hash, KeyEqual>::erase(const Key &key)
+{
+    const auto entry = findEntry(key);
+    if (entry == npos)
+        return 0;
+    erase(const_iterator(m_order.data() + entry, orderEnd()));
+    return 1;
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+template<typename K>
+size_t OrderedHashMap<Key, T, Hash, KeyEqual>::findEntry(const K &key) const noexcept
+{
+    if (!m_index.empty())
+        return findEntry(key, hashOf(key));
+    for (size_t i = 0; i < m_order.size(); ++i) {
+        if (m_order[i] && KeyEqual()(m_order[i]->first, key))
+            return i;
+    }
+    return npos;
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+template<typename K>
+size_t OrderedHashMap<Key, T, Hash, KeyEqual>::findEntry(const K &key, uint32_t hash) const
+    noexcept
+{
+    if (m_index.empty())
+        return findEntry(key);
+    const size_t mask = m_index.size() - 1;
+    // buckets of erased entries are kept until the next rebuild, probing continues past them
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const auto &bucket = m_index[i];
+        if (bucket.entry == EmptyBucket)
+            return npos;
+        const auto entry = m_order[bucket.entry];
+        if (bucket.hash == hash && entry && KeyEqual()(entry->first, key))
+            return bucket.entry;
+    }
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+void OrderedHashMap<Key, T, Hash, KeyEqual>::addToIndex(uint32_t entry, uint32_t hash) noexcept
+{
+    const size_t mask = m_index.size() - 1;
+    size_t i = hash & mask;
+    while (m_index[i].entry != EmptyBucket)
+        i = (i + 1) & mask;
+    m_index[i] = {entry, hash};
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+void OrderedHashMap<Key, T, Hash, KeyEqual>::rebuildIndex(size_t capacity)
+{
+    size_t size = 16;
+    while (size < capacity)
+        size *= 2;
+    auto old = std::exchange(m_index, std::vector<Bucket>(size));
+    if (old.empty()) {
+        for (size_t i = 0; i < m_order.size(); ++i) {
+            if (m_order[i])
+                addToIndex(uint32_t(i), hashOf(m_order[i]->first));
+        }
+        return;
+    }
+    // entry positions did not change, reuse the stored hashes
+    for (const auto &bucket: old) {
+        if (bucket.entry != EmptyBucket && m_order[bucket.entry])
+            addToIndex(bucket.entry, bucket.hash);
+    }
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+void OrderedHashMap<Key, T, Hash, KeyEqual>::compact()
+{
+    // only the order moves, the entries stay where they are
+    m_order.erase(std::remove(m_order.begin(), m_order.end(), nullptr), m_order.end());
+    m_index.clear();
+    if (m_order.size() > IndexThreshold)
+        rebuildIndex(2 * m_order.size());
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+void OrderedHashMap<Key, T, Hash, KeyEqual>::reserveEntries(size_t count)
+{
+    const auto available = m_freeEntries.size() + size_t(m_chunkEnd - m_chunkNext);
+    if (count <= available)
+        return;
+    // the rest of the last chunk is handed out through the free list from now on
+    m_freeEntries.reserve(available);
+    for (; m_chunkNext != m_chunkEnd; ++m_chunkNext)
+        m_freeEntries.push_back(m_chunkNext);
+    const auto size = count - available;
+    m_chunks.push_back(std::make_unique<value_type[]>(size));
+    m_chunkNext = m_chunks.back().get();
+    m_chunkEnd = m_chunkNext + size;
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+auto OrderedHashMap<Key, T, Hash, KeyEqual>::allocateEntry() -> value_type *
+{
+    if (!m_freeEntries.empty()) {
+        const auto result = m_freeEntries.back();
+        m_freeEntries.pop_back();
+        return result;
+    }
+    // grows geometrically like a vector, without moving the existing entries
+    if (m_chunkNext == m_chunkEnd)
+        reserveEntries(std::max(MinChunkSize, m_size));
+    return m_chunkNext++;
+}
+
+// Maps are equal if they have the same entries, regardless of the insertion order
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+bool operator==(const OrderedHashMap<Key, T, Hash, KeyEqual> &lhs,
+                const OrderedHashMap<Key, T, Hash, KeyEqual> &rhs)
+{
+    if (lhs.size() != rhs.size())
+        return false;
+    for (const auto &item: lhs) {
+        const auto it = rhs.find(item.first);
+        if (it == rhs.end() || !(it->second == item.second))
+            return false;
+    }
+    return true;
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+bool operator!=(const OrderedHashMap<Key, T, Hash, KeyEqual> &lhs,
+                const OrderedHashMap<Key, T, Hash, KeyEqual> &rhs)
+{
+    return !(lhs == rhs);
+}
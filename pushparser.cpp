@@ -0,0 +1,864 @@
+#include "pushparser.h"
+
+#include "binaryformat.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+using BinaryFormat::Tag;
+
+namespace {
+
+// Upper bound for reservations based on sizes read from the input
+constexpr uint64_t MaxReserve = 1 << 16;
+// Typed array items reported at once
+constexpr size_t MaxItemsChunk = 4096;
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+bool isNumberChar(char c)
+{
+    return isDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Checks the JSON number grammar, integer is set if there is no fraction or exponent
+bool isJsonNumber(const QByteArray &token, bool &integer)
+{
+    const char *p = token.constData();
+    const size_t size = size_t(token.size());
+    size_t i = 0;
+    const auto digits = [&] {
+        const size_t start = i;
+        while (i < size && isDigit(p[i]))
+            ++i;
+        return i > start;
+    };
+    if (i < size && p[i] == '-')
+        ++i;
+    if (i < size && p[i] == '0')
+        ++i;
+    else if (!digits())
+        return false;
+    integer = true;
+    if (i < size && p[i] == '.') {
+        integer = false;
+        ++i;
+        if (!digits())
+            return false;
+    }
+    if (i < size && (p[i] == 'e' || p[i] == 'E')) {
+        integer = false;
+        ++i;
+        if (i < size && (p[i] == '+' || p[i] == '-'))
+            ++i;
+        if (!digits())
+            return false;
+    }
+    return i == size;
+}
+
+} // namespace
+
+void PushParser::Handler::startItems(Value::Type type, uint64_t count)
+{
+    Q_UNUSED(type);
+    Q_UNUSED(count);
+    startArray();
+}
+
+void PushParser::Handler::items(const Value &items)
+{
+    switch (items.type()) {
+    case Value::Type::StringList:
+        for (const auto &item: items.get<QStringList>())
+            value(item);
+        break;
+    case Value::Type::DoubleArray:
+        for (const auto item: items.get<DoubleArray>())
+            value(item);
+        break;
+    default:
+        for (const auto item: items.get<Int64Array>())
+            value(item);
+        break;
+    }
+}
+
+void PushParser::Handler::endItems()
+{
+    endArray();
+}
+
+class PushParser::TreeBuilder : public PushParser::Handler
+{
+public:
+    void startObject() override { m_stack.push_back({Object(), {}}); }
+    void endObject() override { end(); }
+    void startArray() override { m_stack.push_back({Array(), {}}); }
+    void endArray() override { end(); }
+    void key(const QString &key) override { m_stack.back().key = key; }
+    void value(Value value) override { add(std::move(value)); }
+
+    // the only handler gathering the items, into the value it builds anyway
+    void startItems(Value::Type type, uint64_t count) override
+    {
+        const auto reserved = size_t(std::min(count, MaxReserve));
+        Value items;
+        if (type == Value::Type::StringList) {
+            QStringList list;
+            list.reserve(qsizetype(reserved));
+            items = std::move(list);
+        } else if (type == Value::Type::DoubleArray) {
+            DoubleArray array;
+            array.reserve(reserved);
+            items = std::move(array);
+        } else {
+            Int64Array array;
+            array.reserve(reserved);
+            items = std::move(array);
+        }
+        m_stack.push_back({std::move(items), {}});
+    }
+    void items(const Value &items) override
+    {
+        auto &container = m_stack.back().container;
+        switch (items.type()) {
+        case Value::Type::StringList: {
+            auto &list = container.get<QStringList>();
+            for (const auto &item: items.get<QStringList>())
+                list.append(item);
+            break;
+        }
+        case Value::Type::DoubleArray: {
+            auto &array = container.get<DoubleArray>();
+            const auto &added = items.get<DoubleArray>();
+            array.insert(array.end(), added.begin(), added.end());
+            break;
+        }
+        default: {
+            auto &array = container.get<Int64Array>();
+            const auto &added = items.get<Int64Array>();
+            array.insert(array.end(), added.begin(), added.end());
+            break;
+        }
+        }
+    }
+    void endItems() override { end(); }
+
+    Value take() { return std::exchange(m_result, {}); }
+
+    void reset()
+    {
+        m_stack.clear();
+        m_result = {};
+    }
+
+private:
+    struct Frame
+    {
+        Value container;
+        ObjectKey key;
+    };
+
+    void end()
+    {
+        auto container = std::move(m_stack.back().container);
+        m_stack.pop_back();
+        add(std::move(container));
+    }
+
+    void add(Value value)
+    {
+        if (m_stack.empty()) {
+            m_result = std::move(value);
+            return;
+        }
+        auto &frame = m_stack.back();
+        if (frame.container.type() == Value::Type::Array)
+            frame.container.get<Array>().append(std::move(value));
+        else // a repeated key replaces the earlier value
+            frame.container.get<Object>()[frame.key] = std::move(value);
+    }
+
+    std::vector<Frame> m_stack;
+    Value m_result;
+};
+
+PushParser::PushParser(Format format)
+    : m_format(format)
+    , m_builder(std::make_unique<TreeBuilder>())
+{
+    m_handler = m_builder.get();
+}
+
+PushParser::PushParser(Format format, Handler &handler)
+    : m_format(format)
+    , m_handler(&handler)
+{
+}
+
+PushParser::~PushParser() = default;
+
+auto PushParser::feed(QByteArrayView chunk) -> Status
+{
+    if (m_status == Status::Error)
+        return m_status;
+    if (m_format == Format::Json)
+        feedJson(chunk.data(), size_t(chunk.size()));
+    else
+        feedBinary(chunk.data(), size_t(chunk.size()));
+    m_offset += chunk.size();
+    return m_status;
+}
+
+auto PushParser::finish() -> Status
+{
+    if (m_status == Status::Error)
+        return m_status;
+    if (m_format == Format::Json && m_jsonState == JsonState::Number && !finishNumber(0))
+        return m_status;
+    if (m_status != Status::Complete)
+        fail("Unexpected end of input", 0);
+    return m_status;
+}
+
+Value PushParser::takeValue()
+{
+    if (!m_builder || m_status != Status::Complete)
+        return {};
+    return m_builder->take();
+}
+
+void PushParser::reset()
+{
+    m_status = Status::Incomplete;
+    m_error.clear();
+    m_errorOffset = -1;
+    m_offset = 0;
+    m_stack.clear();
+    m_token.clear();
+    m_jsonState = JsonState::Value;
+    m_highSurrogate = 0;
+    m_binaryState = BinaryState::Tag;
+    m_itemsLeft = 0;
+    if (m_builder)
+        m_builder->reset();
+}
+
+auto PushParser::fail(const char *message, qint64 index) -> Status
+{
+    m_status = Status::Error;
+    m_error = QString::fromLatin1(message);
+    m_errorOffset = m_offset + index;
+    return m_status;
+}
+
+bool PushParser::enter(bool object, qint64 index)
+{
+    if (m_stack.size() >= m_maxDepth) {
+        fail("Document is nested too deeply", index);
+        return false;
+    }
+    m_stack.push_back({object, 0});
+    return true;
+}
+
+void PushParser::feedJson(const char *data, size_t size)
+{
+    size_t i = 0;
+    while (i < size) {
+        const char c = data[i];
+        switch (m_jsonState) {
+        case JsonState::Value:
+            if (!isSpace(c) && !startJsonValue(c, qint64(i)))
+                return;
+            break;
+        case JsonState::ArrayFirst:
+            if (isSpace(c))
+                break;
+            if (c == ']')
+                endJsonContainer();
+            else if (!startJsonValue(c, qint64(i)))
+                return;
+            break;
+        case JsonState::ObjectFirst:
+        case JsonState::Key:
+            if (isSpace(c))
+                break;
+            if (c == '}' && m_jsonState == JsonState::ObjectFirst) {
+                endJsonContainer();
+                break;
+            }
+            if (c != '"') {
+                fail("Expected a key", qint64(i));
+                return;
+            }
+            m_token.resize(0);
+            m_tokenIsKey = true;
+            m_jsonState = JsonState::String;
+            break;
+        case JsonState::Colon:
+            if (isSpace(c))
+                break;
+            if (c != ':') {
+                fail("Expected ':'", qint64(i));
+                return;
+            }
+            m_jsonState = JsonState::Value;
+            break;
+        case JsonState::AfterValue:
+            if (isSpace(c))
+                break;
+            if (c == ',') {
+                m_jsonState = m_stack.back().object ? JsonState::Key : JsonState::Value;
+            } else if (c == (m_stack.back().object ? '}' : ']')) {
+                endJsonContainer();
+            } else {
+                fail(m_stack.back().object ? "Expected ',' or '}'" : "Expected ',' or ']'",
+                     qint64(i));
+                return;
+            }
+            break;
+        case JsonState::String: {
+            // copy the run of plain characters at once
+            size_t end = i;
+            while (end < size && data[end] != '"' && data[end] != '\\' && uint8_t(data[end]) >= 0x20)
+                ++end;
+            if (end > i) {
+                flushSurrogate();
+                m_token.append(data + i, qsizetype(end - i));
+                i = end;
+                continue;
+            }
+            if (c == '\\') {
+                m_jsonState = JsonState::StringEscape;
+                break;
+            }
+            if (c != '"') {
+                fail("Control character in string", qint64(i));
+                return;
+            }
+            flushSurrogate();
+            const auto string = QString::fromUtf8(m_token);
+            m_token.resize(0);
+            if (m_tokenIsKey) {
+                m_handler->key(string);
+                m_jsonState = JsonState::Colon;
+            } else {
+                m_handler->value(string);
+                jsonValueCompleted();
+            }
+            break;
+        }
+        case JsonState::StringEscape: {
+            char decoded = 0;
+            switch (c) {
+            case '"': case '\\': case '/': decoded = c; break;
+            case 'b': decoded = '\b'; break;
+            case 'f': decoded = '\f'; break;
+            case 'n': decoded = '\n'; break;
+            case 'r': decoded = '\r'; break;
+            case 't': decoded = '\t'; break;
+            case 'u':
+                m_unicode = 0;
+                m_unicodeDigits = 0;
+                m_jsonState = JsonState::StringUnicode;
+                break;
+            default:
+                fail("Invalid escape sequence", qint64(i));
+                return;
+            }
+            if (decoded) {
+                flushSurrogate();
+                m_token.append(decoded);
+                m_jsonState = JsonState::String;
+            }
+            break;
+        }
+        case JsonState::StringUnicode: {
+            const int digit = hexDigit(c);
+            if (digit < 0) {
+                fail("Invalid \\u escape sequence", qint64(i));
+                return;
+            }
+            m_unicode = (m_unicode << 4) | uint32_t(digit);
+            if (++m_unicodeDigits == 4) {
+                appendCodePoint(m_unicode);
+                m_jsonState = JsonState::String;
+            }
+            break;
+        }
+        case JsonState::Number:
+            if (isNumberChar(c)) {
+                m_token.append(c);
+                break;
+            }
+            if (!finishNumber(qint64(i)))
+                return;
+            // the character after the number is handled in the new state
+            continue;
+        case JsonState::Literal:
+            if (c != m_literal[m_literalPos]) {
+                fail("Invalid literal", qint64(i));
+                return;
+            }
+            if (!m_literal[++m_literalPos]) {
+                m_handler->value(m_literal[0] == 'n' ? Value() : Value(m_literal[0] == 't'));
+                jsonValueCompleted();
+            }
+            break;
+        case JsonState::Done:
+            if (!isSpace(c)) {
+                fail("Unexpected data after the document", qint64(i));
+                return;
+            }
+            break;
+        }
+        ++i;
+    }
+}
+
+bool PushParser::startJsonValue(char c, qint64 index)
+{
+    switch (c) {
+    case '{':
+        if (!enter(true, index))
+            return false;
+        m_handler->startObject();
+        m_jsonState = JsonState::ObjectFirst;
+        return true;
+    case '[':
+        if (!enter(false, index))
+            return false;
+        m_handler->startArray();
+        m_jsonState = JsonState::ArrayFirst;
+        return true;
+    case '"':
+        m_token.resize(0);
+        m_tokenIsKey = false;
+        m_jsonState = JsonState::String;
+        return true;
+    case 't':
+        m_literal = "true";
+        break;
+    case 'f':
+        m_literal = "false";
+        break;
+    case 'n':
+        m_literal = "null";
+        break;
+    default:
+        if (c != '-' && !isDigit(c)) {
+            fail("Unexpected character", index);
+            return false;
+        }
+        m_token.resize(0);
+        m_token.append(c);
+        m_jsonState = JsonState::Number;
+        return true;
+    }
+    m_literalPos = 1;
+    m_jsonState = JsonState::Literal;
+    return true;
+}
+
+void PushParser::endJsonContainer()
+{
+    const bool object = m_stack.back().object;
+    m_stack.pop_back();
+    if (object)
+        m_handler->endObject();
+    else
+        m_handler->endArray();
+    jsonValueCompleted();
+}
+
+void PushParser::jsonValueCompleted()
+{
+    if (!m_stack.empty()) {
+        m_jsonState = JsonState::AfterValue;
+        return;
+    }
+    m_jsonState = JsonState::Done;
+    m_status = Status::Complete;
+}
+
+void PushParser::appendCodePoint(uint32_t codePoint)
+{
+    if (codePoint >= 0xd800 && codePoint < 0xdc00) {
+        flushSurrogate();
+        m_highSurrogate = codePoint;
+        return;
+    }
+    if (codePoint >= 0xdc00 && codePoint < 0xe000) {
+        if (!m_highSurrogate)
+            codePoint = 0xfffd;
+        else
+            codePoint = 0x10000 + ((m_highSurrogate - 0xd800) << 10) + (codePoint - 0xdc00);
+        m_highSurrogate = 0;
+    } else {
+        flushSurrogate();
+    }
+
+    if (codePoint < 0x80) {
+        m_token.append(char(codePoint));
+    } else if (codePoint < 0x800) {
+        m_token.append(char(0xc0 | (codePoint >> 6)));
+        m_token.append(char(0x80 | (codePoint & 0x3f)));
+    } else if (codePoint < 0x10000) {
+        m_token.append(char(0xe0 | (codePoint >> 12)));
+        m_token.append(char(0x80 | ((codePoint >> 6) & 0x3f)));
+        m_token.append(char(0x80 | (codePoint & 0x3f)));
+    } else {
+        m_token.append(char(0xf0 | (codePoint >> 18)));
+        m_token.append(char(0x80 | ((codePoint >> 12) & 0x3f)));
+        m_token.append(char(0x80 | ((codePoint >> 6) & 0x3f)));
+        m_token.append(char(0x80 | (codePoint & 0x3f)));
+    }
+}
+
+void PushParser::flushSurrogate()
+{
+    // a high surrogate not followed by a low one
+    if (m_highSurrogate) {
+        m_highSurrogate = 0;
+        appendCodePoint(0xfffd);
+    }
+}
+
+bool PushParser::finishNumber(qint64 index)
+{
+    bool integer = false;
+    if (!isJsonNumber(m_token, integer)) {
+        fail("Invalid number", index - m_token.size());
+        return false;
+    }
+    Value value;
+    bool ok = false;
+    if (integer) {
+        const qint64 number = m_token.toLongLong(&ok);
+        if (ok && number >= INT32_MIN && number <= INT32_MAX)
+            value = int32_t(number);
+        else if (ok)
+            value = int64_t(number);
+        else if (m_token.at(0) != '-')
+            value = uint64_t(m_token.toULongLong(&ok));
+    }
+    // fractions, exponents and integers out of range
+    if (!ok)
+        value = m_token.toDouble();
+    m_handler->value(std::move(value));
+    jsonValueCompleted();
+    return true;
+}
+
+void PushParser::feedBinary(const char *data, size_t size)
+{
+    size_t i = 0;
+    while (i < size) {
+        const auto byte = uint8_t(data[i]);
+        switch (m_binaryState) {
+        case BinaryState::Tag:
+            if (!startBinaryValue(byte, qint64(i)))
+                return;
+            ++i;
+            break;
+        case BinaryState::Varint:
+            if (m_varintShift >= 7 * BinaryFormat::MaxVarintSize) {
+                fail("Invalid varint", qint64(i));
+                return;
+            }
+            m_varint |= uint64_t(byte & 0x7f) << m_varintShift;
+            m_varintShift += 7;
+            ++i;
+            if (!(byte & 0x80) && !varintCompleted(qint64(i) - 1))
+                return;
+            break;
+        case BinaryState::Bytes: {
+            const auto count = std::min<uint64_t>(m_bytesLeft, size - i);
+            m_token.append(data + i, qsizetype(count));
+            i += count;
+            m_bytesLeft -= count;
+            if (!m_bytesLeft)
+                bytesCompleted();
+            break;
+        }
+        case BinaryState::Fixed:
+            if (m_field == Field::TypedItem && m_fixedPos == 0 && size - i >= 8) {
+                // decode the elements available in this chunk at once
+                const auto count = size_t(std::min<uint64_t>(
+                        {m_itemsLeft, (size - i) / 8, MaxItemsChunk}));
+                typedItems(data + i, count);
+                i += 8 * count;
+                m_itemsLeft -= count;
+                if (!m_itemsLeft)
+                    itemsCompleted();
+                break;
+            }
+            m_fixed[m_fixedPos++] = byte;
+            ++i;
+            if (m_fixedPos == m_fixedSize)
+                fixedCompleted();
+            break;
+        case BinaryState::Done:
+            fail("Unexpected data after the document", qint64(i));
+            return;
+        }
+    }
+}
+
+bool PushParser::startBinaryValue(uint8_t tag, qint64 index)
+{
+    m_tag = tag;
+    switch (Tag(tag)) {
+    case Tag::Null:
+        m_handler->value(Value());
+        nextBinaryEntry();
+        return true;
+    case Tag::False:
+    case Tag::True:
+        m_handler->value(Tag(tag) == Tag::True);
+        nextBinaryEntry();
+        return true;
+    case Tag::Int32:
+    case Tag::UInt32:
+        readFixed(Field::Scalar, 4);
+        return true;
+    case Tag::Int64:
+    case Tag::UInt64:
+    case Tag::Double:
+        readFixed(Field::Scalar, 8);
+        return true;
+    case Tag::String:
+    case Tag::CompactString:
+        readVarint(Field::Length);
+        return true;
+    case Tag::StringList:
+    case Tag::Array:
+    case Tag::Object:
+    case Tag::DoubleArray:
+    case Tag::Int64Array:
+        readVarint(Field::Count);
+        return true;
+    }
+    fail("Invalid tag", index);
+    return false;
+}
+
+bool PushParser::varintCompleted(qint64 index)
+{
+    const uint64_t value = m_varint;
+    switch (m_field) {
+    case Field::Length:
+        readBytes(Field::String, value);
+        return true;
+    case Field::KeyLength:
+        readBytes(Field::Key, value);
+        return true;
+    case Field::ListItemLength:
+        readBytes(Field::ListItem, value);
+        return true;
+    default:
+        break;
+    }
+
+    // a count
+    switch (Tag(m_tag)) {
+    case Tag::Array:
+    case Tag::Object: {
+        const bool object = Tag(m_tag) == Tag::Object;
+        if (!enter(object, index))
+            return false;
+        m_stack.back().remaining = value;
+        if (object)
+            m_handler->startObject();
+        else
+            m_handler->startArray();
+        nextBinaryEntry();
+        return true;
+    }
+    case Tag::StringList:
+        m_handler->startItems(Value::Type::StringList, value);
+        break;
+    case Tag::DoubleArray:
+        m_handler->startItems(Value::Type::DoubleArray, value);
+        break;
+    default:
+        m_handler->startItems(Value::Type::Int64Array, value);
+        break;
+    }
+    m_itemsLeft = value;
+    if (!m_itemsLeft)
+        itemsCompleted();
+    else if (Tag(m_tag) == Tag::StringList)
+        readVarint(Field::ListItemLength);
+    else
+        readFixed(Field::TypedItem, 8);
+    return true;
+}
+
+void PushParser::bytesCompleted()
+{
+    switch (m_field) {
+    case Field::Key:
+        m_handler->key(QString::fromUtf8(m_token));
+        m_binaryState = BinaryState::Tag;
+        break;
+    case Field::ListItem:
+        m_handler->items(QStringList{QString::fromUtf8(m_token)});
+        if (--m_itemsLeft)
+            readVarint(Field::ListItemLength);
+        else
+            itemsCompleted();
+        break;
+    default:
+        if (Tag(m_tag) == Tag::CompactString)
+            m_handler->value(CompactString(m_token.constData(), size_t(m_token.size())));
+        else
+            m_handler->value(QString::fromUtf8(m_token));
+        nextBinaryEntry();
+        break;
+    }
+}
+
+void PushParser::fixedCompleted()
+{
+    if (m_field == Field::TypedItem) {
+        typedItems(reinterpret_cast<const char *>(m_fixed), 1);
+        if (--m_itemsLeft)
+            readFixed(Field::TypedItem, 8);
+        else
+            itemsCompleted();
+        return;
+    }
+
+    uint64_t bits = 0;
+    for (uint8_t i = 0; i < m_fixedSize; ++i)
+        bits |= uint64_t(m_fixed[i]) << (8 * i);
+    Value value;
+    switch (Tag(m_tag)) {
+    case Tag::Int32:
+        value = int32_t(uint32_t(bits));
+        break;
+    case Tag::UInt32:
+        value = uint32_t(bits);
+        break;
+    case Tag::Int64:
+        value = int64_t(bits);
+        break;
+    case Tag::UInt64:
+        value = uint64_t(bits);
+        break;
+    default: {
+        double number;
+        std::memcpy(&number, &bits, sizeof(number));
+        value = number;
+        break;
+    }
+    }
+    m_handler->value(std::move(value));
+    nextBinaryEntry();
+}
+
+void PushParser::typedItems(const char *data, size_t count)
+{
+    const auto decode = [data](size_t item) {
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; ++i)
+            bits |= uint64_t(uint8_t(data[8 * item + i])) << (8 * i);
+        return bits;
+    };
+    if (Tag(m_tag) == Tag::DoubleArray) {
+        DoubleArray items;
+        items.reserve(count);
+        for (size_t item = 0; item < count; ++item) {
+            const uint64_t bits = decode(item);
+            double number;
+            std::memcpy(&number, &bits, sizeof(number));
+            items.append(number);
+        }
+        m_handler->items(std::move(items));
+    } else {
+        Int64Array items;
+        items.reserve(count);
+        for (size_t item = 0; item < count; ++item)
+            items.append(int64_t(decode(item)));
+        m_handler->items(std::move(items));
+    }
+}
+
+void PushParser::itemsCompleted()
+{
+    m_handler->endItems();
+    nextBinaryEntry();
+}
+
+void PushParser::nextBinaryEntry()
+{
+    while (!m_stack.empty()) {
+        auto &frame = m_stack.back();
+        if (frame.remaining) {
+            --frame.remaining;
+            if (frame.object)
+                readVarint(Field::KeyLength);
+            else
+                m_binaryState = BinaryState::Tag;
+            return;
+        }
+        const bool object = frame.object;
+        m_stack.pop_back();
+        if (object)
+            m_handler->endObject();
+        else
+            m_handler->endArray();
+    }
+    m_binaryState = BinaryState::Done;
+    m_status = Status::Complete;
+}
+
+void PushParser::readVarint(Field field)
+{
+    m_field = field;
+    m_varint = 0;
+    m_varintShift = 0;
+    m_binaryState = BinaryState::Varint;
+}
+
+void PushParser::readBytes(Field field, uint64_t size)
+{
+    m_field = field;
+    m_token.resize(0);
+    m_token.reserve(qsizetype(std::min(size, MaxReserve)));
+    m_bytesLeft = size;
+    m_binaryState = BinaryState::Bytes;
+    if (!size)
+        bytesCompleted();
+}
+
+void PushParser::readFixed(Field field, uint8_t size)
+{
+    m_field = field;
+    m_fixedSize = size;
+    m_fixedPos = 0;
+    m_binaryState = BinaryState::Fixed;
+}
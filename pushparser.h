@@ -0,0 +1,186 @@
+#pragma once
+
+#include "variant.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QByteArrayView>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Incremental parser for JSON and for the native binary encoding (see binaryformat.h).
+// Input is pushed in chunks of any size with feed(); a token split between chunks is resumed
+// by the next call. The state kept between calls is the stack of open containers and the
+// token being read, so memory is bounded by the document nesting and its longest string.
+//
+// By default the parser builds the Value tree, available from takeValue() once the document
+// is complete. Given a Handler, it reports events instead and keeps no tree; the items of
+// string lists and typed arrays are then reported as they are decoded, not gathered.
+class PushParser
+{
+public:
+    enum class Format {
+        Json,
+        Binary
+    };
+
+    enum class Status {
+        Incomplete,
+        Complete,
+        Error
+    };
+
+    // Receives the document as a sequence of events. Object members are reported as key()
+    // followed by the value; scalars and strings arrive as value().
+    //
+    // String lists and typed arrays arrive as startItems() with their type and the count read
+    // from the input, which is not checked, then items() with pieces of that type as they are
+    // decoded, and endItems(). By default they are reported like an array, as startArray(), a
+    // value() per item and endArray().
+    class Handler
+    {
+    public:
+        virtual ~Handler() = default;
+        virtual void startObject() = 0;
+        virtual void endObject() = 0;
+        virtual void startArray() = 0;
+        virtual void endArray() = 0;
+        virtual void key(const QString &key) = 0;
+        virtual void value(Value value) = 0;
+        virtual void startItems(Value::Type type, uint64_t count);
+        virtual void items(const Value &items);
+        virtual void endItems();
+    };
+
+    static constexpr size_t DefaultMaxDepth = 512;
+
+    explicit PushParser(Format format = Format::Json);
+    PushParser(Format format, Handler &handler);
+    PushParser(const PushParser &) = delete;
+    PushParser &operator=(const PushParser &) = delete;
+    ~PushParser();
+
+    Format format() const noexcept { return m_format; }
+
+    // Parses the next chunk of input
+    Status feed(QByteArrayView chunk);
+    // Marks the end of input, which completes a top-level JSON number
+    Status finish();
+    Status status() const noexcept { return m_status; }
+    QString errorString() const { return m_error; }
+    // Offset of the byte where the error was found, counted from the start of the input
+    qint64 errorOffset() const noexcept { return m_errorOffset; }
+
+    // The parsed document in tree mode, null until the status is Complete
+    Value takeValue();
+    // Prepares for a new document
+    void reset();
+
+    // Deeper documents are rejected
+    size_t maxDepth() const noexcept { return m_maxDepth; }
+    void setMaxDepth(size_t depth) noexcept { m_maxDepth = depth; }
+
+private:
+    class TreeBuilder;
+
+    enum class JsonState : uint8_t {
+        Value,
+        ArrayFirst,
+        ObjectFirst,
+        Key,
+        Colon,
+        AfterValue,
+        String,
+        StringEscape,
+        StringUnicode,
+        Number,
+        Literal,
+        Done
+    };
+
+    enum class BinaryState : uint8_t {
+        Tag,
+        Varint,
+        Bytes,
+        Fixed,
+        Done
+    };
+
+    // what the varint, bytes or fixed-size field being read is for
+    enum class Field : uint8_t {
+        Count,
+        Length,
+        ListItemLength,
+        KeyLength,
+        String,
+        ListItem,
+        Key,
+        Scalar,
+        TypedItem
+    };
+
+    struct Frame
+    {
+        bool object;
+        // entries left to read, binary format only
+        uint64_t remaining;
+    };
+
+    // index is relative to the chunk being fed
+    Status fail(const char *message, qint64 index);
+    bool enter(bool object, qint64 index);
+
+    void feedJson(const char *data, size_t size);
+    bool startJsonValue(char c, qint64 index);
+    void endJsonContainer();
+    void jsonValueCompleted();
+    void appendCodePoint(uint32_t codePoint);
+    void flushSurrogate();
+    bool finishNumber(qint64 index);
+
+    void feedBinary(const char *data, size_t size);
+    bool startBinaryValue(uint8_t tag, qint64 index);
+    bool varintCompleted(qint64 index);
+    void bytesCompleted();
+    void fixedCompleted();
+    void typedItems(const char *data, size_t count);
+    void itemsCompleted();
+    void nextBinaryEntry();
+    void readVarint(Field field);
+    void readBytes(Field field, uint64_t size);
+    void readFixed(Field field, uint8_t size);
+
+    Format m_format;
+    Handler *m_handler;
+    std::unique_ptr<TreeBuilder> m_builder;
+    Status m_status{Status::Incomplete};
+    QString m_error;
+    qint64 m_errorOffset{-1};
+    qint64 m_offset{0};
+    size_t m_maxDepth{DefaultMaxDepth};
+    std::vector<Frame> m_stack;
+
+    // token being read
+    QByteArray m_token;
+    bool m_tokenIsKey{false};
+
+    JsonState m_jsonState{JsonState::Value};
+    const char *m_literal{nullptr};
+    uint8_t m_literalPos{0};
+    uint8_t m_unicodeDigits{0};
+    uint32_t m_unicode{0};
+    uint32_t m_highSurrogate{0};
+
+    BinaryState m_binaryState{BinaryState::Tag};
+    Field m_field{Field::Count};
+    uint8_t m_tag{0};
+    uint64_t m_varint{0};
+    uint8_t m_varintShift{0};
+    uint64_t m_bytesLeft{0};
+    uint8_t m_fixed[8]{};
+    uint8_t m_fixedSize{0};
+    uint8_t m_fixedPos{0};
+    // items left in the string list or typed array being read
+    uint64_t m_itemsLeft{0};
+};
@@ -0,0 +1,129 @@
+#include "reclaimer.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+// Counts the nodes of the tree, stopping as soon as limit is reached
+size_t countNodes(const Value &value, size_t limit)
+{
+    size_t count = 1;
+    if (const auto array = value.getIf<Array>()) {
+        for (const auto &item: *array) {
+            if (count >= limit)
+                break;
+            count += countNodes(item, limit - count);
+        }
+    } else if (const auto object = value.getIf<Object>()) {
+        for (const auto &item: *object) {
+            if (count >= limit)
+                break;
+            count += countNodes(item.second, limit - count);
+        }
+    } else if (const auto list = value.getIf<QStringList>()) {
+        count += size_t(list->size());
+    }
+    return count;
+}
+
+} // namespace
+
+Reclaimer::Reclaimer(size_t threshold, size_t nodeBudget)
+    : m_threshold(threshold)
+    , m_nodeBudget(nodeBudget)
+{
+}
+
+Reclaimer::~Reclaimer()
+{
+    stop();
+}
+
+Reclaimer &Reclaimer::instance()
+{
+    static Reclaimer *reclaimer = [] {
+        std::atexit([] { instance().stop(); });
+        return new Reclaimer;
+    }();
+    return *reclaimer;
+}
+
+bool Reclaimer::release(Value value)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const size_t available = m_stopping ? 0 : m_nodeBudget - m_pendingNodes;
+    lock.unlock();
+
+    // counting stops past what the queue can take
+    const size_t nodes = countNodes(value, std::max(m_threshold, available + 1));
+    lock.lock();
+    if (nodes < m_threshold || m_stopping || nodes > m_nodeBudget - m_pendingNodes) {
+        ++m_statistics.synchronous;
+        lock.unlock();
+        return false;
+    }
+    m_queue.push_back({std::move(value), nodes});
+    ++m_pending;
+    m_pendingNodes += nodes;
+    ++m_statistics.deferred;
+    if (!m_thread.joinable())
+        m_thread = std::thread([this] { run(); });
+    lock.unlock();
+    m_wakeUp.notify_one();
+    return true;
+}
+
+void Reclaimer::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_pending == 0; });
+}
+
+size_t Reclaimer::pending() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending;
+}
+
+auto Reclaimer::statistics() const -> Statistics
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+void Reclaimer::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_wakeUp.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+        // the queue is drained before stopping
+        if (m_queue.empty())
+            return;
+        Entry entry = std::move(m_queue.front());
+        m_queue.pop_front();
+        lock.unlock();
+        entry.value = Value();
+        lock.lock();
+        m_pendingNodes -= entry.nodes;
+        if (--m_pending == 0)
+            m_idle.notify_all();
+    }
+}
+
+void Reclaimer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeUp.notify_one();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void Value::releaseAsync()
+{
+    Reclaimer::instance().release(std::move(*this));
+    clear();
+}
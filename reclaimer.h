@@ -0,0 +1,76 @@
+#pragma once
+
+#include "variant.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Destroys large Value trees on a background thread, so dropping them does not stall the
+// calling thread. Trees below the size threshold are destroyed synchronously, as are trees
+// that would take the nodes waiting in the queue over the node budget, which bounds the
+// memory held by the queue. The thread is started on the first deferred release and joined
+// by the destructor.
+class Reclaimer
+{
+public:
+    // Trees with fewer nodes are destroyed on the calling thread
+    static constexpr size_t DefaultThreshold = 1024;
+    // Maximum number of nodes waiting for destruction, counting shared ones as if they were not
+    static constexpr size_t DefaultNodeBudget = 1 << 20;
+
+    struct Statistics
+    {
+        size_t deferred{0};
+        size_t synchronous{0};
+    };
+
+    explicit Reclaimer(size_t threshold = DefaultThreshold,
+                       size_t nodeBudget = DefaultNodeBudget);
+    Reclaimer(const Reclaimer &) = delete;
+    Reclaimer &operator=(const Reclaimer &) = delete;
+    // Destroys the pending trees and stops the thread
+    ~Reclaimer();
+
+    // Instance used by Value::releaseAsync(). It is never destroyed, so that destructors of
+    // static objects can use it, but it stops at exit, and destroys synchronously from then on.
+    static Reclaimer &instance();
+
+    // Takes ownership of the value and destroys it. Returns true if the destruction was
+    // handed to the background thread.
+    bool release(Value value);
+    // Blocks until all trees released so far are destroyed
+    void flush();
+
+    size_t threshold() const noexcept { return m_threshold; }
+    size_t nodeBudget() const noexcept { return m_nodeBudget; }
+    // Number of trees queued or being destroyed
+    size_t pending() const;
+    Statistics statistics() const;
+
+private:
+    struct Entry
+    {
+        Value value;
+        size_t nodes;
+    };
+
+    void run();
+    // Destroys the pending trees and joins the thread, later releases are synchronous
+    void stop();
+
+    const size_t m_threshold;
+    const size_t m_nodeBudget;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_idle;
+    std::deque<Entry> m_queue;
+    size_t m_pending{0};
+    // nodes of the trees queued or being destroyed
+    size_t m_pendingNodes{0};
+    bool m_stopping{false};
+    Statistics m_statistics;
+    std::thread m_thread;
+};
@@ -0,0 +1,275 @@
+#include "shapedobject.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+// Keys of a chain of shapes, in slot order. Only the shape whose size is the table's size may
+// append to it, so a key is at most once in a table and lookups only have to check that the
+// slot found belongs to the shape. Appends happen under the mutex while other threads read,
+// readers only look at slots published through the atomic buckets or below their shape's size.
+class Shape::KeyTable
+{
+public:
+    explicit KeyTable(size_t capacity)
+        : m_capacity(capacity)
+        , m_keys(new QString[capacity])
+    {
+        size_t buckets = 16;
+        while (buckets < 2 * capacity)
+            buckets *= 2;
+        m_buckets.reset(new std::atomic<uint64_t>[buckets]);
+        for (size_t i = 0; i < buckets; ++i)
+            m_buckets[i].store(0, std::memory_order_relaxed);
+        m_mask = buckets - 1;
+    }
+
+    // Copy of the first size keys with room for more
+    static std::shared_ptr<KeyTable> copy(const KeyTable &other, size_t size)
+    {
+        auto result = std::make_shared<KeyTable>(std::max(2 * size + 1, IndexThreshold));
+        for (size_t i = 0; i < size; ++i)
+            result->tryAppend(i, other.m_keys[i]);
+        return result;
+    }
+
+    const QString &key(size_t slot) const noexcept { return m_keys[slot]; }
+
+    // True if key is at slot afterwards: either it was added there by an earlier shape of the
+    // same size, or slot is the end of the table and there is room for it
+    bool tryAppend(size_t slot, const QString &key)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_size > slot)
+            return StringKeyEqual()(m_keys[slot], key);
+        if (m_size < slot || m_size == m_capacity)
+            return false;
+        m_keys[slot] = key;
+        const uint64_t hash = uint32_t(StringKeyHash()(key));
+        size_t i = hash & m_mask;
+        while (m_buckets[i].load(std::memory_order_relaxed))
+            i = (i + 1) & m_mask;
+        m_buckets[i].store(hash << 32 | (slot + 1), std::memory_order_release);
+        ++m_size;
+        return true;
+    }
+
+    // Slot of key among the first size keys, or npos
+    size_t find(const QString &key, size_t size) const noexcept
+    {
+        if (size <= IndexThreshold) {
+            for (size_t i = 0; i < size; ++i) {
+                if (StringKeyEqual()(m_keys[i], key))
+                    return i;
+            }
+            return npos;
+        }
+        const uint64_t hash = uint32_t(StringKeyHash()(key));
+        for (size_t i = hash & m_mask;; i = (i + 1) & m_mask) {
+            const auto bucket = m_buckets[i].load(std::memory_order_acquire);
+            if (!bucket)
+                return npos;
+            const size_t slot = (bucket & 0xffffffff) - 1;
+            if (bucket >> 32 == hash && StringKeyEqual()(m_keys[slot], key))
+                return slot < size ? slot : npos;
+        }
+    }
+
+private:
+    // Small shapes are searched linearly, larger ones use the buckets
+    static constexpr size_t IndexThreshold = 8;
+
+    std::mutex m_mutex;
+    size_t m_size{0};
+    const size_t m_capacity;
+    std::unique_ptr<QString[]> m_keys;
+    // hash << 32 | (slot + 1), 0 if empty
+    std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+    size_t m_mask;
+};
+
+Shape::Shape(PrivateTag)
+    : m_table(std::make_shared<KeyTable>(8))
+{
+}
+
+Shape::Shape(PrivateTag, Pointer parent, const QString &key)
+    : m_parent(std::move(parent))
+    , m_table(m_parent->m_table)
+    , m_size(m_parent->m_size + 1)
+{
+    // share the parent's table unless another chain already continues it
+    if (!m_table->tryAppend(m_parent->m_size, key)) {
+        m_table = KeyTable::copy(*m_table, m_parent->m_size);
+        m_table->tryAppend(m_parent->m_size, key);
+    }
+}
+
+auto Shape::empty() -> Pointer
+{
+    static const Pointer root = std::make_shared<const Shape>(PrivateTag());
+    return root;
+}
+
+auto Shape::fromKeys(const QStringList &keys) -> Pointer
+{
+    Pointer result = empty();
+    for (const auto &key: keys)
+        result = result->withKey(key);
+    return result;
+}
+
+const QString &Shape::key(size_t slot) const
+{
+    if (slot >= m_size)
+        throw std::out_of_range("Shape::key: no such slot");
+    return m_table->key(slot);
+}
+
+QStringList Shape::keys() const
+{
+    QStringList result;
+    result.reserve(qsizetype(m_size));
+    for (size_t i = 0; i < m_size; ++i)
+        result.append(m_table->key(i));
+    return result;
+}
+
+size_t Shape::slot(const QString &key) const noexcept
+{
+    return m_table->find(key, m_size);
+}
+
+auto Shape::withKey(const QString &key) const -> Pointer
+{
+    if (slot(key) != npos)
+        return shared_from_this();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto it = m_transitions.find(key);
+    if (it != m_transitions.end()) {
+        if (auto result = it->second.lock())
+            return result;
+    } else if (m_transitions.size() >= m_pruneSize) {
+        // shapes no longer used by any object, amortized over the insertions since last time
+        for (auto expired = m_transitions.begin(); expired != m_transitions.end();) {
+            if (expired->second.expired())
+                expired = m_transitions.erase(expired);
+            else
+                ++expired;
+        }
+        m_pruneSize = std::max(size_t(8), 2 * m_transitions.size());
+    }
+    auto result = std::make_shared<const Shape>(PrivateTag(), shared_from_this(), key);
+    m_transitions[key] = result;
+    return result;
+}
+
+auto Shape::withoutKey(const QString &key) const -> Pointer
+{
+    const auto removed = slot(key);
+    if (removed == npos)
+        return shared_from_this();
+
+    // walk up to the shape before the key was added and replay the keys after it
+    const Shape *base = this;
+    while (base->size() > removed)
+        base = base->parent();
+    Pointer result = base->shared_from_this();
+    for (size_t i = removed + 1; i < m_size; ++i)
+        result = result->withKey(m_table->key(i));
+    return result;
+}
+
+ShapedObject::ShapedObject()
+    : m_shape(Shape::empty())
+{
+}
+
+ShapedObject::ShapedObject(const Object &object)
+    : m_shape(Shape::empty())
+{
+    m_values.reserve(object.size());
+    for (const auto &item: object) {
+        m_shape = m_shape->withKey(toQString(item.first));
+        m_values.push_back(item.second);
+    }
+}
+
+ShapedObject::ShapedObject(std::initializer_list<std::pair<QString, Value>> list)
+    : m_shape(Shape::empty())
+{
+    m_values.reserve(list.size());
+    for (const auto &item: list)
+        insert(item);
+}
+
+Object ShapedObject::toObject() const
+{
+    Object result;
+    result.reserve(size());
+    for (size_t i = 0; i < m_values.size(); ++i)
+        result.insert({m_shape->key(i), m_values[i]});
+    return result;
+}
+
+const Value &ShapedObject::at(const QString &key) const
+{
+    const auto slot = m_shape->slot(key);
+    if (slot == Shape::npos)
+        throw std::out_of_range("ShapedObject::at: no such key");
+    return m_values[slot];
+}
+
+const Value &ShapedObject::at(const QString &key, ShapeCache &cache) const
+{
+    const auto slot = cachedSlot(key, cache);
+    if (slot == Shape::npos)
+        throw std::out_of_range("ShapedObject::at: no such key");
+    return m_values[slot];
+}
+
+bool ShapedObject::insert(std::pair<QString, Value> value)
+{
+    if (m_shape->slot(value.first) != Shape::npos)
+        return false;
+    m_shape = m_shape->withKey(value.first);
+    m_values.push_back(std::move(value.second));
+    return true;
+}
+
+size_t ShapedObject::erase(const QString &key)
+{
+    const auto slot = m_shape->slot(key);
+    if (slot == Shape::npos)
+        return 0;
+    m_shape = m_shape->withoutKey(key);
+    m_values.erase(m_values.begin() + std::ptrdiff_t(slot));
+    return 1;
+}
+
+Value &ShapedObject::operator[](const QString &key)
+{
+    auto slot = m_shape->slot(key);
+    if (slot == Shape::npos) {
+        m_shape = m_shape->withKey(key);
+        slot = m_values.size();
+        m_values.emplace_back();
+    }
+    return m_values[slot];
+}
+
+bool operator==(const ShapedObject &lhs, const ShapedObject &rhs)
+{
+    if (lhs.size() != rhs.size())
+        return false;
+    if (&lhs.shape() == &rhs.shape())
+        return lhs.values() == rhs.values();
+    // same keys added in a different order
+    for (const auto item: lhs) {
+        const auto it = rhs.find(item.first);
+        if (it == rhs.end() || it.value() != item.second)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "variant.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Immutable description of a key set, shared by all ShapedObjects having the same keys
+// added in the same order. Maps keys to slots in ShapedObject's value array.
+// Adding a key transitions to a child shape; transitions are cached, so objects built the
+// same way end up with the same Shape instance.
+// A shape does not copy its parent's keys: shapes along a chain of transitions share one
+// append-only key table, which is only copied where the chain branches.
+class Shape : public std::enable_shared_from_this<Shape>
+{
+    struct PrivateTag {};
+    class KeyTable;
+
+public:
+    using Pointer = std::shared_ptr<const Shape>;
+
+    static constexpr size_t npos = size_t(-1);
+
+    Shape(const Shape &) = delete;
+    Shape &operator=(const Shape &) = delete;
+
+    // The shape without keys, root of all transitions
+    static Pointer empty();
+    static Pointer fromKeys(const QStringList &keys);
+
+    size_t size() const noexcept { return m_size; }
+    const QString &key(size_t slot) const;
+    QStringList keys() const;
+    const Shape *parent() const noexcept { return m_parent.get(); }
+
+    // Returns npos if there is no such key
+    size_t slot(const QString &key) const noexcept;
+
+    Pointer withKey(const QString &key) const;
+    Pointer withoutKey(const QString &key) const;
+
+    // Use empty() and withKey() to obtain shapes
+    explicit Shape(PrivateTag);
+    Shape(PrivateTag, Pointer parent, const QString &key);
+
+private:
+    Pointer m_parent;
+    // holds at least m_size keys, the first m_size are this shape's
+    std::shared_ptr<KeyTable> m_table;
+    size_t m_size{0};
+
+    mutable std::mutex m_mutex;
+    mutable std::unordered_map<QString, std::weak_ptr<const Shape>, StringKeyHash, StringKeyEqual>
+            m_transitions;
+    // expired transitions are removed when the map reaches this size
+    mutable size_t m_pruneSize{8};
+};
+
+// Per call-site lookup cache for ShapedObject, remembers the slot found for the last shape.
+// Not thread-safe; use a thread_local or a per-thread instance when shared between threads.
+struct ShapeCache
+{
+    const Shape *shape{nullptr};
+    size_t slot{0};
+};
+
+// Object that stores only a dense array of values, the keys are kept by a shared Shape.
+// Provides the lookup API of Object.
+class ShapedObject
+{
+public:
+    class const_iterator;
+
+    ShapedObject();
+    explicit ShapedObject(const Object &object);
+    ShapedObject(std::initializer_list<std::pair<QString, Value>> list);
+
+    Object toObject() const;
+
+    const Shape &shape() const noexcept { return *m_shape; }
+    const Shape::Pointer &shapePointer() const noexcept { return m_shape; }
+    const std::vector<Value> &values() const noexcept { return m_values; }
+
+    const_iterator begin() const noexcept;
+    const_iterator cbegin() const noexcept;
+    const_iterator constBegin() const noexcept;
+    const_iterator end() const noexcept;
+    const_iterator cend() const noexcept;
+    const_iterator constEnd() const noexcept;
+
+    const Value &at(const QString &key) const;
+    const Value &at(const QString &key, ShapeCache &cache) const;
+    const_iterator find(const QString &key) const noexcept;
+    const_iterator find(const QString &key, ShapeCache &cache) const noexcept;
+    template<typename T = Value>
+    T value(const QString &key, T defaultValue = {}) const;
+
+    bool empty() const noexcept { return m_values.empty(); }
+    bool isEmpty() const noexcept { return empty(); }
+    size_t size() const noexcept { return m_values.size(); }
+    bool contains(const QString &key) const noexcept { return m_shape->slot(key) != Shape::npos; }
+
+    bool insert(std::pair<QString, Value> value);
+    size_t erase(const QString &key);
+
+    Value &operator[](const QString &key);
+
+private:
+    size_t cachedSlot(const QString &key, ShapeCache &cache) const noexcept;
+
+    Shape::Pointer m_shape;
+    std::vector<Value> m_values;
+};
+
+class ShapedObject::const_iterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = std::pair<const QString &, const Value &>;
+    using reference = value_type;
+
+    inline const_iterator() noexcept = default;
+    inline const_iterator(const ShapedObject *object, size_t slot) noexcept
+        : o(object), s(slot) {}
+
+    inline size_t slot() const noexcept { return s; }
+    inline const QString &key() const { return o->m_shape->key(s); }
+    inline const Value &value() const { return o->m_values[s]; }
+
+    inline reference operator*() const { return {key(), value()}; }
+
+    inline bool operator==(const const_iterator &other) const noexcept { return s == other.s; }
+    inline bool operator!=(const const_iterator &other) const noexcept { return s != other.s; }
+
+    inline const_iterator &operator++() noexcept { ++s; return *this; }
+    inline const_iterator operator++(int) noexcept { const_iterator n = *this; ++s; return n; }
+
+private:
+    const ShapedObject *o{nullptr};
+    size_t s{0};
+};
+
+inline auto ShapedObject::begin() const noexcept -> const_iterator { return {this, 0}; }
+inline auto ShapedObject::cbegin() const noexcept -> const_iterator { return begin(); }
+inline auto ShapedObject::constBegin() const noexcept -> const_iterator { return begin(); }
+inline auto ShapedObject::end() const noexcept -> const_iterator { return {this, size()}; }
+inline auto ShapedObject::cend() const noexcept -> const_iterator { return end(); }
+inline auto ShapedObject::constEnd() const noexcept -> const_iterator { return end(); }
+
+inline auto ShapedObject::find(const QString &key) const noexcept -> const_iterator
+{
+    const auto slot = m_shape->slot(key);
+    return slot == Shape::npos ? end() : const_iterator(this, slot);
+}
+
+inline auto ShapedObject::find(const QString &key, ShapeCache &cache) const noexcept
+    -> const_iterator
+{
+    const auto slot = cachedSlot(key, cache);
+    return slot == Shape::npos ? end() : const_iterator(this, slot);
+}
+
+inline size_t ShapedObject::cachedSlot(const QString &key, ShapeCache &cache) const noexcept
+{
+    // The key check guards against a new shape allocated at the address of a destroyed one
+    const Shape *shape = m_shape.get();
+    if (cache.shape == shape && cache.slot < shape->size()
+            && StringKeyEqual()(shape->key(cache.slot), key)) {
+        return cache.slot;
+    }
+    const auto slot = shape->slot(key);
+    if (slot != Shape::npos) {
+        cache.shape = shape;
+        cache.slot = slot;
+    }
+    return slot;
+}
+
+template<typename T>
+inline T ShapedObject::value(const QString &key, T defaultValue) const
+{
+    const auto slot = m_shape->slot(key);
+    if (slot == Shape::npos)
+        return defaultValue;
+    if constexpr (std::is_same_v<T, Value>)
+        return m_values[slot];
+    else
+        return m_values[slot].value<T>(std::move(defaultValue));
+}
+
+bool operator==(const ShapedObject &lhs, const ShapedObject &rhs);
+
+inline bool operator!=(const ShapedObject &lhs, const ShapedObject &rhs)
+{
+    return !(lhs == rhs);
+}
@@ -0,0 +1,377 @@
+#include "stringkernels.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define STRINGKERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define STRINGKERNELS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define STRINGKERNELS_TARGET(isa)
+#endif
+
+// The hash splits the input into blocks of 16 characters (8 x 32 bit words) which are mixed
+// into 8 independent 32 bit lanes. The lanes are then folded into a 64 bit state together with
+// the tail. Every implementation computes the very same lanes, so the result does not depend
+// on the ISA. Keys shorter than a block never touch the lanes.
+
+namespace StringKernels {
+
+namespace {
+
+constexpr size_t BlockChars = 16;
+constexpr size_t LaneCount = 8;
+constexpr uint32_t LaneMul = 0x85ebca77u;
+constexpr uint32_t LaneInit = 0x9e3779b1u;
+constexpr int LaneShift = 13;
+constexpr uint64_t StateMul = 0x9e3779b97f4a7c15ull;
+
+using LanesFunction = void (*)(uint32_t *lanes, const char16_t *data, size_t blocks);
+using Latin1LanesFunction = void (*)(uint32_t *lanes, const char *data, size_t blocks);
+using EqualFunction = bool (*)(const char16_t *lhs, const char16_t *rhs, size_t size);
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t finalize(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+void lanesScalar(uint32_t *lanes, const char16_t *data, size_t blocks)
+{
+    for (size_t block = 0; block < blocks; ++block, data += BlockChars) {
+        for (size_t j = 0; j < LaneCount; ++j) {
+            const uint32_t word = uint32_t(data[2 * j]) | (uint32_t(data[2 * j + 1]) << 16);
+            uint32_t lane = (lanes[j] ^ word) * LaneMul;
+            lanes[j] = lane ^ (lane >> LaneShift);
+        }
+    }
+}
+
+// Same as lanesScalar() on the characters widened to UTF-16
+void latin1LanesScalar(uint32_t *lanes, const char *data, size_t blocks)
+{
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data);
+    for (size_t block = 0; block < blocks; ++block, bytes += BlockChars) {
+        for (size_t j = 0; j < LaneCount; ++j) {
+            const uint32_t word = uint32_t(bytes[2 * j]) | (uint32_t(bytes[2 * j + 1]) << 16);
+            uint32_t lane = (lanes[j] ^ word) * LaneMul;
+            lanes[j] = lane ^ (lane >> LaneShift);
+        }
+    }
+}
+
+bool equalScalar(const char16_t *lhs, const char16_t *rhs, size_t size)
+{
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        uint64_t a, b;
+        std::memcpy(&a, lhs + i, sizeof(a));
+        std::memcpy(&b, rhs + i, sizeof(b));
+        if (a != b)
+            return false;
+    }
+    for (; i < size; ++i) {
+        if (lhs[i] != rhs[i])
+            return false;
+    }
+    return true;
+}
+
+#if defined(STRINGKERNELS_X86)
+
+STRINGKERNELS_TARGET("sse2")
+inline __m128i mullo32(__m128i a, __m128i b)
+{
+    // SSE2 has no 32 bit low multiplication, emulate it with two 32x32->64 ones
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+STRINGKERNELS_TARGET("sse2")
+void lanesSse2(uint32_t *lanes, const char16_t *data, size_t blocks)
+{
+    const __m128i mul = _mm_set1_epi32(int(LaneMul));
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes + 4));
+    for (size_t block = 0; block < blocks; ++block, data += BlockChars) {
+        const __m128i wordsLo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        const __m128i wordsHi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 8));
+        lo = mullo32(_mm_xor_si128(lo, wordsLo), mul);
+        hi = mullo32(_mm_xor_si128(hi, wordsHi), mul);
+        lo = _mm_xor_si128(lo, _mm_srli_epi32(lo, LaneShift));
+        hi = _mm_xor_si128(hi, _mm_srli_epi32(hi, LaneShift));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), lo);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes + 4), hi);
+}
+
+STRINGKERNELS_TARGET("sse2")
+void latin1LanesSse2(uint32_t *lanes, const char *data, size_t blocks)
+{
+    const __m128i mul = _mm_set1_epi32(int(LaneMul));
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes + 4));
+    for (size_t block = 0; block < blocks; ++block, data += BlockChars) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        const __m128i wordsLo = _mm_unpacklo_epi8(bytes, zero);
+        const __m128i wordsHi = _mm_unpackhi_epi8(bytes, zero);
+        lo = mullo32(_mm_xor_si128(lo, wordsLo), mul);
+        hi = mullo32(_mm_xor_si128(hi, wordsHi), mul);
+        lo = _mm_xor_si128(lo, _mm_srli_epi32(lo, LaneShift));
+        hi = _mm_xor_si128(hi, _mm_srli_epi32(hi, LaneShift));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), lo);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes + 4), hi);
+}
+
+STRINGKERNELS_TARGET("sse2")
+bool equalSse2(const char16_t *lhs, const char16_t *rhs, size_t size)
+{
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(a, b)) != 0xffff)
+            return false;
+    }
+    return equalScalar(lhs + i, rhs + i, size - i);
+}
+
+STRINGKERNELS_TARGET("avx2")
+void lanesAvx2(uint32_t *lanes, const char16_t *data, size_t blocks)
+{
+    const __m256i mul = _mm256_set1_epi32(int(LaneMul));
+    __m256i state = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lanes));
+    for (size_t block = 0; block < blocks; ++block, data += BlockChars) {
+        const __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        state = _mm256_mullo_epi32(_mm256_xor_si256(state, words), mul);
+        state = _mm256_xor_si256(state, _mm256_srli_epi32(state, LaneShift));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), state);
+}
+
+STRINGKERNELS_TARGET("avx2")
+void latin1LanesAvx2(uint32_t *lanes, const char *data, size_t blocks)
+{
+    const __m256i mul = _mm256_set1_epi32(int(LaneMul));
+    __m256i state = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lanes));
+    for (size_t block = 0; block < blocks; ++block, data += BlockChars) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        const __m256i words = _mm256_cvtepu8_epi16(bytes);
+        state = _mm256_mullo_epi32(_mm256_xor_si256(state, words), mul);
+        state = _mm256_xor_si256(state, _mm256_srli_epi32(state, LaneShift));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), state);
+}
+
+STRINGKERNELS_TARGET("avx2")
+bool equalAvx2(const char16_t *lhs, const char16_t *rhs, size_t size)
+{
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rhs + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(a, b)) != -1)
+            return false;
+    }
+    return equalSse2(lhs + i, rhs + i, size - i);
+}
+
+#endif // STRINGKERNELS_X86
+
+struct Kernels
+{
+    LanesFunction lanes;
+    Latin1LanesFunction latin1Lanes;
+    EqualFunction equal;
+};
+
+const Kernels &kernels(Isa isa)
+{
+#if defined(STRINGKERNELS_X86)
+    static const Kernels table[] = {
+        {lanesScalar, latin1LanesScalar, equalScalar},
+        {lanesSse2, latin1LanesSse2, equalSse2},
+        {lanesAvx2, latin1LanesAvx2, equalAvx2},
+    };
+    return table[int(isa)];
+#else
+    Q_UNUSED(isa);
+    static const Kernels scalar = {lanesScalar, latin1LanesScalar, equalScalar};
+    return scalar;
+#endif
+}
+
+std::atomic<Isa> &currentIsaRef()
+{
+    static std::atomic<Isa> isa{detectedIsa()};
+    return isa;
+}
+
+} // namespace
+
+Isa detectedIsa() noexcept
+{
+#if defined(STRINGKERNELS_X86)
+#if defined(__GNUC__) || defined(__clang__)
+    static const Isa isa = __builtin_cpu_supports("avx2")
+            ? Isa::Avx2
+            : __builtin_cpu_supports("sse2") ? Isa::Sse2 : Isa::Scalar;
+#elif defined(_MSC_VER)
+    static const Isa isa = [] {
+        int info[4] = {};
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        const bool sse2 = (info[3] & (1 << 26)) != 0;
+        if (osxsave && avx && (_xgetbv(0) & 6) == 6) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5))
+                return Isa::Avx2;
+        }
+        return sse2 ? Isa::Sse2 : Isa::Scalar;
+    }();
+#else
+    static const Isa isa = Isa::Scalar;
+#endif
+    return isa;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+Isa currentIsa() noexcept
+{
+    return currentIsaRef().load(std::memory_order_relaxed);
+}
+
+void setIsa(Isa isa) noexcept
+{
+    if (int(isa) > int(detectedIsa()))
+        isa = detectedIsa();
+    currentIsaRef().store(isa, std::memory_order_relaxed);
+}
+
+namespace {
+
+inline uint64_t initialState(size_t size, size_t seed)
+{
+    return uint64_t(seed) ^ ((uint64_t(size) + 1) * StateMul);
+}
+
+inline void initLanes(uint32_t *lanes, size_t seed)
+{
+    const uint64_t seed64 = uint64_t(seed);
+    for (size_t j = 0; j < LaneCount; ++j)
+        lanes[j] = uint32_t(seed64) ^ uint32_t(seed64 >> 32) ^ (LaneInit * uint32_t(j + 1));
+}
+
+inline uint64_t foldLanes(uint64_t h, const uint32_t *lanes)
+{
+    for (size_t j = 0; j < LaneCount; ++j)
+        h = rotl((h ^ lanes[j]) * StateMul, 31);
+    return h;
+}
+
+template<typename Char>
+inline uint64_t mixTail(uint64_t h, const Char *data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+        h = (h ^ std::make_unsigned_t<Char>(data[i])) * StateMul;
+    return h;
+}
+
+template<typename Char, typename Lanes>
+size_t hashChars(const Char *data, size_t size, size_t seed, Lanes lanesFunction) noexcept
+{
+    uint64_t h = initialState(size, seed);
+
+    const size_t blocks = size / BlockChars;
+    if (blocks > 0) {
+        uint32_t lanes[LaneCount];
+        initLanes(lanes, seed);
+        lanesFunction(lanes, data, blocks);
+        h = foldLanes(h, lanes);
+    }
+
+    h = mixTail(h, data + blocks * BlockChars, size - blocks * BlockChars);
+    return size_t(finalize(h));
+}
+
+} // namespace
+
+size_t hashUtf16(const char16_t *data, size_t size, size_t seed) noexcept
+{
+    return hashChars(data, size, seed, kernels(currentIsa()).lanes);
+}
+
+size_t hashLatin1(const char *data, size_t size, size_t seed) noexcept
+{
+    return hashChars(data, size, seed, kernels(currentIsa()).latin1Lanes);
+}
+
+bool equalUtf16(const char16_t *lhs, const char16_t *rhs, size_t size) noexcept
+{
+    if (lhs == rhs)
+        return true;
+    if (size < 8)
+        return equalScalar(lhs, rhs, size);
+    return kernels(currentIsa()).equal(lhs, rhs, size);
+}
+
+static_assert(Utf16Hasher::BlockChars == BlockChars, "Utf16Hasher feeds whole blocks");
+
+// The lanes are folded into the state before the tail is mixed in, which is at the first
+// add() that does not end on a block boundary, or in result(). Texts shorter than a block
+// have no lanes to fold.
+Utf16Hasher::Utf16Hasher(size_t size, size_t seed) noexcept
+    : m_state(initialState(size, seed))
+    , m_folded(size < BlockChars)
+{
+    initLanes(m_lanes, seed);
+}
+
+void Utf16Hasher::add(const char16_t *data, size_t size) noexcept
+{
+    const size_t blocks = size / BlockChars;
+    if (blocks > 0)
+        kernels(currentIsa()).lanes(m_lanes, data, blocks);
+    if (blocks * BlockChars < size) {
+        foldLanes();
+        m_state = mixTail(m_state, data + blocks * BlockChars, size - blocks * BlockChars);
+    }
+}
+
+size_t Utf16Hasher::result() noexcept
+{
+    foldLanes();
+    return size_t(finalize(m_state));
+}
+
+void Utf16Hasher::foldLanes() noexcept
+{
+    if (!m_folded) {
+        m_state = StringKernels::foldLanes(m_state, m_lanes);
+        m_folded = true;
+    }
+}
+
+} // namespace StringKernels
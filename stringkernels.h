@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QtCore/QString>
+#include <QtCore/QStringView>
+
+#include <cstddef>
+#include <cstdint>
+
+// Hash and equality kernels for UTF-16 buffers.
+// The implementation is chosen at runtime depending on the CPU (scalar, SSE2 or AVX2);
+// all implementations return exactly the same results.
+namespace StringKernels {
+
+enum class Isa {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+// Best ISA supported by the current CPU
+Isa detectedIsa() noexcept;
+// ISA used by hashUtf16(), hashLatin1() and equalUtf16()
+Isa currentIsa() noexcept;
+// Overrides the dispatch, used in tests and benchmarks. The isa is clamped to detectedIsa()
+void setIsa(Isa isa) noexcept;
+
+size_t hashUtf16(const char16_t *data, size_t size, size_t seed = 0) noexcept;
+// Same as hashUtf16() of the characters widened to UTF-16, without converting them
+size_t hashLatin1(const char *data, size_t size, size_t seed = 0) noexcept;
+bool equalUtf16(const char16_t *lhs, const char16_t *rhs, size_t size) noexcept;
+
+// Computes hashUtf16() of text that is produced piecewise, e.g. while it is decoded into a
+// small buffer. The total size has to be known up front and every add() but the last one
+// must pass a multiple of BlockChars characters.
+class Utf16Hasher
+{
+public:
+    static constexpr size_t BlockChars = 16;
+
+    explicit Utf16Hasher(size_t size, size_t seed = 0) noexcept;
+    void add(const char16_t *data, size_t size) noexcept;
+    // The hash, once all characters have been added
+    size_t result() noexcept;
+
+private:
+    void foldLanes() noexcept;
+
+    uint64_t m_state;
+    uint32_t m_lanes[8];
+    bool m_folded;
+};
+
+inline const char16_t *utf16(const QString &s) noexcept
+{
+    return reinterpret_cast<const char16_t *>(s.constData());
+}
+
+inline size_t hash(const QString &s, size_t seed = 0) noexcept
+{
+    return hashUtf16(utf16(s), size_t(s.size()), seed);
+}
+
+inline size_t hash(QStringView s, size_t seed = 0) noexcept
+{
+    return hashUtf16(reinterpret_cast<const char16_t *>(s.utf16()), size_t(s.size()), seed);
+}
+
+inline bool equal(const QString &lhs, const QString &rhs) noexcept
+{
+    return lhs.size() == rhs.size() && equalUtf16(utf16(lhs), utf16(rhs), size_t(lhs.size()));
+}
+
+} // namespace StringKernels
@@ -1,7 +1,215 @@
 #include <QtTest>
 
+#include "arrayindex.h"
+#include "binaryformat.h"
+#include "binding.h"
+#include "changetracker.h"
+#include "concurrentobject.h"
+#include "constvalue.h"
+#include "copytracker.h"
+#include "pushparser.h"
+#include "reclaimer.h"
+#include "shapedobject.h"
+#include "valuecache.h"
+#include "valuepool.h"
 #include "variant.h"
 
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <string_view>
+
+enum class Language { Cpp, C, ObjC };
+
+struct Flags
+{
+    QStringList defines;
+    std::optional<bool> optimize;
+};
+
+struct FileRecord
+{
+    QString path;
+    int64_t size{};
+    double weight{};
+    Language language{};
+    Flags flags;
+    std::vector<int> lines;
+    std::optional<QString> comment;
+};
+
+template<> struct ValueBinding<Flags>
+{
+    static constexpr auto fields = std::make_tuple(
+            field("defines", &Flags::defines),
+            field("optimize", &Flags::optimize));
+};
+
+template<> struct ValueBinding<FileRecord>
+{
+    static constexpr auto fields = std::make_tuple(
+            field("path", &FileRecord::path),
+            field("size", &FileRecord::size),
+            field("weight", &FileRecord::weight),
+            field("language", &FileRecord::language),
+            field("flags", &FileRecord::flags),
+            field("lines", &FileRecord::lines),
+            field("comment", &FileRecord::comment));
+};
+
+static QString makeKey(int length, int salt = 0)
+{
+    QString result;
+    result.reserve(length);
+    for (int i = 0; i < length; ++i)
+        result.append(QChar(char16_t(0x20 + (i * 7 + salt) % 0x5e + (i % 5 == 0 ? 0x400 : 0))));
+    return result;
+}
+
+// Number of occupied buckets when hashes are put into 2^16 buckets by their low bits
+template<typename Hashes>
+static size_t usedBuckets(const Hashes &hashes)
+{
+    std::vector<bool> buckets(1 << 16);
+    for (const auto hash: hashes)
+        buckets[hash & 0xffff] = true;
+    return size_t(std::count(buckets.begin(), buckets.end(), true));
+}
+
+// Values of a typical per-file build configuration
+static QStringList configStrings(int file)
+{
+    return {
+        QString("src/module%1/file%2.cpp").arg(file % 17).arg(file),
+        "gcc",
+        "c++17",
+        "x86_64-linux-gnu",
+        QString("-DMODULE_%1").arg(file % 17),
+        "release",
+        QString("build/obj/file%1.o").arg(file),
+    };
+}
+
+template<typename String>
+static Array makeConfig(int files)
+{
+    static const QStringList keys{
+        "path", "compiler", "standard", "target", "define", "variant", "output"};
+    Array result;
+    result.reserve(size_t(files));
+    for (int file = 0; file < files; ++file) {
+        const auto values = configStrings(file);
+        Object record;
+        record.reserve(size_t(keys.size()));
+        for (qsizetype i = 0; i < keys.size(); ++i)
+            record.insert({keys.at(i), String(values.at(i))});
+        result.append(record);
+    }
+    return result;
+}
+
+// Per-file configuration where the option sets repeat across files, as in generated projects
+static Array makeBuildGraph(int files)
+{
+    Array result;
+    result.reserve(size_t(files));
+    for (int file = 0; file < files; ++file) {
+        const int variant = file % 4;
+        Array defines;
+        defines.append(QString("MODULE_%1").arg(variant));
+        defines.append(QString("NDEBUG"));
+        Object options;
+        options.insert({"compiler", QString("gcc")});
+        options.insert({"standard", QString("c++17")});
+        options.insert({"optimize", variant != 0});
+        options.insert({"defines", defines});
+        Object record;
+        record.insert({"path", QString("src/file%1.cpp").arg(file)});
+        record.insert({"flags", QStringList{"-Wall", "-Wextra", QString("-O%1").arg(variant)}});
+        record.insert({"options", options});
+        result.append(record);
+    }
+    return result;
+}
+
+// Static defaults, built at compile time
+namespace ConstDefaults {
+constexpr ConstValue defines[] = {u"MODULE_0", u"NDEBUG"};
+constexpr ConstValue flags[] = {u"-Wall", u"-Wextra", u"-O0"};
+constexpr ConstEntry options[] = {
+    {u"compiler", u"gcc"},
+    {u"standard", u"c++17"},
+    {u"optimize", false},
+    {u"defines", defines},
+};
+constexpr ConstEntry limits[] = {
+    {u"jobs", 8},
+    {u"memory", uint64_t(1) << 34},
+    {u"ratio", 0.75},
+    {u"timeout", int64_t(-1)},
+};
+constexpr ConstEntry record[] = {
+    {u"path", u"src/file0.cpp"},
+    {u"flags", flags},
+    {u"options", options},
+    {u"limits", limits},
+    {u"outputs", ConstValue::emptyArray()},
+    {u"environment", ConstValue::emptyObject()},
+    {u"cache", ConstValue()},
+};
+constexpr ConstValue defaults = record;
+
+static_assert(ValueView(defaults)[u"options"][u"compiler"].toStringView() == u"gcc");
+static_assert(ValueView(defaults)[u"limits"][u"jobs"].toInt64() == 8);
+} // namespace ConstDefaults
+
+// The same defaults as ConstDefaults, the way a dynamic initializer builds them
+static Object makeDynamicDefaults()
+{
+    Array defines;
+    defines.append(QString("MODULE_0"));
+    defines.append(QString("NDEBUG"));
+    Array flags;
+    flags.append(QString("-Wall"));
+    flags.append(QString("-Wextra"));
+    flags.append(QString("-O0"));
+    Object options;
+    options.insert({"compiler", QString("gcc")});
+    options.insert({"standard", QString("c++17")});
+    options.insert({"optimize", false});
+    options.insert({"defines", defines});
+    Object limits;
+    limits.insert({"jobs", 8});
+    limits.insert({"memory", uint64_t(1) << 34});
+    limits.insert({"ratio", 0.75});
+    limits.insert({"timeout", int64_t(-1)});
+    Object record;
+    record.insert({"path", QString("src/file0.cpp")});
+    record.insert({"flags", flags});
+    record.insert({"options", options});
+    record.insert({"limits", limits});
+    record.insert({"outputs", Array()});
+    record.insert({"environment", Object()});
+    record.insert({"cache", Value()});
+    return record;
+}
+
+static void addKeyLengths()
+{
+    QTest::addColumn<int>("length");
+    for (int length: {4, 16, 64, 256})
+        QTest::newRow(QByteArray::number(length).constData()) << length;
+}
+
+// Fails the test if the statements deep-copy an Array or Object. Checks nothing unless built
+// with RECURSIVEVARIANT_TRACK_COPIES.
+#define QVERIFY_NO_DEEP_COPIES(...) \
+    do { \
+        const CopyCounter copyCounter; \
+        __VA_ARGS__; \
+        QVERIFY2(copyCounter.deepCopies() == 0, qPrintable(copyCounter.toString())); \
+    } while (false)
+
 class TestValue: public QObject
 {
     Q_OBJECT
@@ -12,8 +220,63 @@ private slots:
     void testValueSimple();
     void testNumbers();
     void testObjectSimple();
+    void testTypedArray();
+    void testStringKernels();
+    void testHashQuality();
+    void testBinding();
+    void testShapedObject();
+    void testCompactString();
+    void testCompactStringMemory();
+    void testValuePool();
+    void testImplicitSharing();
+    void testOrderedHashMap();
+    void testReclaimer();
+    void testChangeTracker();
+    void testPushParser();
+    void testConstValue();
+    void testArrayIndex();
+    void testConcurrentObject();
+    void testValueCache();
+    void testCopyTracker();
     void benchObject();
     void benchQVariantHash();
+    void benchArraySum();
+    void benchDoubleArraySum();
+    void benchHashRange();
+    void benchHashValue();
+    void benchShapedObject();
+    void benchShapedObjectCached();
+    void benchObjectCached();
+    void benchStringConfig();
+    void benchCompactStringConfig();
+    void benchObjectIteration();
+    void benchValuePool();
+    void benchDestroyLatency();
+    void benchReleaseAsyncLatency();
+    void benchEquality();
+    void benchPooledEquality();
+    void benchJsonParse();
+    void benchBinaryParse();
+    void benchDynamicDefaults();
+    void benchConstDefaults();
+    void benchConstDefaultsToValue();
+    void benchArrayScan();
+    void benchArrayIndexFind();
+    void benchArrayIndexRebuild_data();
+    void benchArrayIndexRebuild();
+    void benchConcurrentObject_data();
+    void benchConcurrentObject();
+    void benchUnorderedMapMemo();
+    void benchValueCacheMemo_data();
+    void benchValueCacheMemo();
+    void benchBinding();
+    void benchManualBinding();
+    void benchKeyHash_data();
+    void benchKeyHash();
+    void benchQtKeyHash_data();
+    void benchQtKeyHash();
+    void benchKeyEqual_data();
+    void benchKeyEqual();
 };
 
 void TestValue::testValueSimple()
@@ -234,6 +497,1534 @@ void TestValue::testObjectSimple()
     QCOMPARE(subojectRef, object[QLatin1String("subobject")].value<Object>());
 }
 
+void TestValue::testTypedArray()
+{
+    DoubleArray doubles{1., -2.5, 3., 0.5, 7., -8., 9., 10., 11.};
+    QCOMPARE(doubles.size(), size_t(9));
+    QCOMPARE(doubles.sum(), 31.);
+    QCOMPARE(doubles.min(), -8.);
+    QCOMPARE(doubles.max(), 11.);
+    QCOMPARE(doubles.count(3.), size_t(1));
+    QCOMPARE(doubles.indexOf(10.), size_t(7));
+    QCOMPARE(doubles.indexOf(42.), doubles.size());
+    QCOMPARE(DoubleArray().sum(), 0.);
+    QCOMPARE(DoubleArray().min(), 0.);
+
+    Int64Array ints;
+    for (int64_t i = 0; i < 100; ++i)
+        ints.append(i - 50);
+    QCOMPARE(ints.sum(), int64_t(-50));
+    QCOMPARE(ints.min(), int64_t(-50));
+    QCOMPARE(ints.max(), int64_t(49));
+    QVERIFY(ints.contains(0));
+    QVERIFY(!ints.contains(50));
+
+    const Array array = doubles.toArray();
+    QCOMPARE(array.size(), doubles.size());
+    QCOMPARE(array.at(1).value<double>(), -2.5);
+    QCOMPARE(DoubleArray::fromArray(array), doubles);
+    QCOMPARE(Int64Array::fromArray(ints.toArray()), ints);
+
+    Array mixed;
+    mixed.append(1);
+    mixed.append(int64_t(2));
+    mixed.append(3.);
+    QCOMPARE(DoubleArray::fromArray(mixed), DoubleArray({1., 2., 3.}));
+    mixed.append(QString("4"));
+    try {
+        DoubleArray::fromArray(mixed);
+        QVERIFY2(false, "Conversion of non-numeric Array should throw");
+    } catch (const std::runtime_error &) {
+    }
+
+    // numbers are converted only if the array type represents them exactly
+    QCOMPARE(Int64Array::fromArray(DoubleArray({-3., 4.}).toArray()), Int64Array({-3, 4}));
+    for (const Value &inexact: {Value(2.5), Value(1e19), Value(std::nan("")),
+                                Value(uint64_t(INT64_MAX) + 1)}) {
+        Array array;
+        array.append(inexact);
+        try {
+            Int64Array::fromArray(array);
+            QVERIFY2(false, "Conversion of an inexact number should throw");
+        } catch (const std::range_error &) {
+        }
+    }
+    Array large;
+    large.append(int64_t(1) << 53);
+    QCOMPARE(DoubleArray::fromArray(large), DoubleArray({9007199254740992.}));
+    large.append((int64_t(1) << 53) + 1);
+    try {
+        DoubleArray::fromArray(large);
+        QVERIFY2(false, "Conversion of an integer rounded by double should throw");
+    } catch (const std::range_error &) {
+    }
+    QCOMPARE(exactCast<int32_t>(int64_t(INT32_MIN)), std::optional<int32_t>(INT32_MIN));
+    QVERIFY(!exactCast<int32_t>(uint32_t(INT32_MAX) + 1));
+    QVERIFY(!exactCast<uint32_t>(-1));
+    QVERIFY(!exactCast<int64_t>(9223372036854775808.));
+    QCOMPARE(exactCast<int64_t>(-9223372036854775808.), std::optional<int64_t>(INT64_MIN));
+    QVERIFY(!exactCast<double>(uint64_t(UINT64_MAX)));
+    QVERIFY(!exactCast<float>(0.1));
+    QVERIFY(std::isnan(*exactCast<float>(std::nan(""))));
+
+    Value value(doubles);
+    QCOMPARE(value.type(), Value::Type::DoubleArray);
+    QCOMPARE(value.value<DoubleArray>(), doubles);
+    QCOMPARE(value.value<Array>(), Array());
+    // typed and generic arrays are different representations and never compare equal
+    QVERIFY(value != Value(array));
+    QVERIFY(Value(DoubleArray({1.})) != Value(Int64Array({1})));
+    QCOMPARE(Value(DoubleArray::fromArray(array)), value);
+    QCOMPARE(Value(value.get<DoubleArray>().toArray()), Value(array));
+    QCOMPARE(std::hash<Value>()(value), std::hash<Value>()(Value(doubles)));
+    QCOMPARE(Value::fromQVariant(value.toQVariant()), value);
+    QCOMPARE(Value::fromQVariant(Value(ints).toQVariant()), Value(ints));
+
+    DoubleArray other = doubles;
+    QCOMPARE(other, doubles);
+    other[8] = 12.;
+    QVERIFY(other != doubles);
+    QCOMPARE(DoubleArray({0.}), DoubleArray({-0.}));
+    QCOMPARE(std::hash<DoubleArray>()(DoubleArray({0.})), std::hash<DoubleArray>()(DoubleArray({-0.})));
+}
+
+void TestValue::testStringKernels()
+{
+    using namespace StringKernels;
+    const auto detected = detectedIsa();
+    for (int length = 0; length < 300; length += length < 40 ? 1 : 17) {
+        const auto key = makeKey(length);
+        std::string latin1;
+        for (int i = 0; i < length; ++i)
+            latin1 += char(0x20 + (i * 37) % 0xe0);
+        const auto widened = QString::fromLatin1(latin1.data(), qsizetype(latin1.size()));
+        setIsa(Isa::Scalar);
+        const auto scalarHash = hash(key);
+        const auto seededHash = hash(key, 42);
+        const auto widenedHash = hash(widened, 42);
+        for (int isa = int(Isa::Scalar); isa <= int(detected); ++isa) {
+            setIsa(Isa(isa));
+            QCOMPARE(hash(key), scalarHash);
+            QCOMPARE(hash(key, 42), seededHash);
+            QCOMPARE(hash(QStringView(key), 42), seededHash);
+            QCOMPARE(hashLatin1(latin1.data(), latin1.size(), 42), widenedHash);
+
+            Utf16Hasher hasher(size_t(length), 42);
+            size_t offset = 0;
+            for (; offset + 2 * Utf16Hasher::BlockChars <= size_t(length); offset += 2 * Utf16Hasher::BlockChars)
+                hasher.add(utf16(key) + offset, 2 * Utf16Hasher::BlockChars);
+            hasher.add(utf16(key) + offset, size_t(length) - offset);
+            QCOMPARE(hasher.result(), seededHash);
+        }
+        for (int isa = int(Isa::Scalar); isa <= int(detected); ++isa) {
+            setIsa(Isa(isa));
+            QVERIFY(equal(key, makeKey(length)));
+            for (int i = 0; i < length; ++i) {
+                auto other = key;
+                other.data()[i] = QChar(char16_t(key.at(i).unicode() ^ 0x100));
+                QVERIFY(!equal(key, other));
+                QVERIFY(hash(key) != hash(other));
+            }
+        }
+    }
+    setIsa(detected);
+    QCOMPARE(currentIsa(), detected);
+
+    QVERIFY(std::hash<QStringList>()({"a", "b"}) != std::hash<QStringList>()({"ab"}));
+    QVERIFY(std::hash<QStringList>()({"a", "b"}) != std::hash<QStringList>()({"b", "a"}));
+    QVERIFY(std::hash<QStringList>()({""}) != std::hash<QStringList>()({"", ""}));
+
+    Object object;
+    for (int i = 0; i < 100; ++i)
+        object.insert({makeKey(i, i), i});
+    for (int i = 0; i < 100; ++i)
+        QCOMPARE(object.value(makeKey(i, i)).value<int>(), i);
+    QVERIFY(!object.contains(makeKey(10, 11)));
+}
+
+void TestValue::testHashQuality()
+{
+    // for a random function 65536 keys occupy 65536 * (1 - 1/e) ~ 41427 buckets out of 65536
+    const size_t expectedBuckets = 40000;
+
+    std::vector<size_t> pairHashes;
+    std::vector<size_t> arrayHashes;
+    std::vector<size_t> listHashes;
+    for (int i = 0; i < 256; ++i) {
+        for (int j = 0; j < 256; ++j) {
+            pairHashes.push_back(std::hash<std::pair<int, int>>()({i, j}));
+            Array array;
+            array.append(i);
+            array.append(j);
+            arrayHashes.push_back(std::hash<Array>()(array));
+            listHashes.push_back(std::hash<QStringList>()(
+                    {QString::number(i), QString::number(j)}));
+        }
+    }
+    QVERIFY(usedBuckets(pairHashes) > expectedBuckets);
+    QVERIFY(usedBuckets(arrayHashes) > expectedBuckets);
+    QVERIFY(usedBuckets(listHashes) > expectedBuckets);
+    for (auto *hashes: {&pairHashes, &arrayHashes, &listHashes}) {
+        std::sort(hashes->begin(), hashes->end());
+        QVERIFY(std::adjacent_find(hashes->begin(), hashes->end()) == hashes->end());
+    }
+
+    // equal objects must have equal hashes regardless of the insertion history
+    Object forward;
+    Object backward;
+    for (int i = 0; i < 100; ++i) {
+        forward.insert({QString::number(i), i});
+        backward.insert({QString::number(99 - i), 99 - i});
+    }
+    backward.insert({"tmp", 0});
+    for (int i = 100; i < 1000; ++i)
+        backward.insert({QString::number(i), i});
+    for (int i = 100; i < 1000; ++i)
+        backward.erase(QString::number(i));
+    backward.erase("tmp");
+    QCOMPARE(forward, backward);
+    QCOMPARE(std::hash<Object>()(forward), std::hash<Object>()(backward));
+    QCOMPARE(std::hash<Value>()(forward), std::hash<Value>()(backward));
+
+    // an operand equal to its secret must not cancel the other one
+    const auto &secrets = Hashing::secrets();
+    QVERIFY(Hashing::combine(1, size_t(secrets.k1)) != Hashing::combine(2, size_t(secrets.k1)));
+    QVERIFY(Hashing::combine(size_t(secrets.k0), 1) != Hashing::combine(size_t(secrets.k0), 2));
+    QCOMPARE(hashUnordered(std::vector<int>{1, 2, 3}), hashUnordered(std::vector<int>{3, 1, 2}));
+    QVERIFY(hashUnordered(std::vector<int>{1, 2, 3}) != hashUnordered(std::vector<int>{1, 2, 4}));
+
+    QVERIFY(std::hash<Value>()(Value(1)) != std::hash<Value>()(Value(1u)));
+    QVERIFY(std::hash<Value>()(Value(QString("1"))) != std::hash<Value>()(Value(QStringList{"1"})));
+    QVERIFY(std::hash<Array>()(Array()) != std::hash<Object>()(Object()));
+}
+
+void TestValue::testBinding()
+{
+    static_assert(BindingDetail::keyHash("path") != BindingDetail::keyHash("size"));
+
+    FileRecord record;
+    record.path = "src/main.cpp";
+    record.size = int64_t(1) << 40;
+    record.weight = 0.5;
+    record.language = Language::ObjC;
+    record.flags.defines = QStringList{"NDEBUG", "QT_NO_CAST"};
+    record.lines = {1, 2, 3};
+
+    const Value value = toValue(record);
+    const auto &object = value.get<Object>();
+    QCOMPARE(object.size(), size_t(6));
+    QVERIFY(!object.contains("comment"));
+    QCOMPARE(object.value("path").value<QString>(), QString("src/main.cpp"));
+    QCOMPARE(object.value("size").value<int64_t>(), int64_t(1) << 40);
+    QCOMPARE(object.value("language").value<int64_t>(), int64_t(Language::ObjC));
+    QCOMPARE(object.value("flags").get<Object>().size(), size_t(1));
+    QCOMPARE(object.value("lines").get<Array>().size(), size_t(3));
+
+    FileRecord copy;
+    copy.comment = QString("stale");
+    auto status = fromValue(value, copy);
+    QVERIFY(status.ok());
+    QCOMPARE(copy.path, record.path);
+    QCOMPARE(copy.size, record.size);
+    QCOMPARE(copy.weight, record.weight);
+    QVERIFY(copy.language == record.language);
+    QCOMPARE(copy.flags.defines, record.flags.defines);
+    QVERIFY(!copy.flags.optimize);
+    QVERIFY(copy.lines == record.lines);
+    QVERIFY(!copy.comment);
+
+    record.flags.optimize = true;
+    record.comment = QString("generated");
+    status = fromValue(toValue(record), copy);
+    QVERIFY(status.ok());
+    QCOMPARE(copy.flags.optimize, std::optional<bool>(true));
+    QCOMPARE(copy.comment, std::optional<QString>(QString("generated")));
+
+    // numbers are converted between the numeric alternatives
+    Object changed = object;
+    changed["weight"] = 2;
+    changed["unknown"] = QString("ignored");
+    QVERIFY(fromValue(Value(changed), copy).ok());
+    QCOMPARE(copy.weight, 2.);
+
+    changed["path"] = 42;
+    status = fromValue(Value(changed), copy);
+    QVERIFY(status.error == BindingError::TypeMismatch);
+    QCOMPARE(QString(status.field), QString("path"));
+
+    changed = object;
+    changed.erase("size");
+    status = fromValue(Value(changed), copy);
+    QVERIFY(status.error == BindingError::MissingField);
+    QCOMPARE(QString(status.field), QString("size"));
+
+    changed = object;
+    changed["flags"].get<Object>()["defines"] = true;
+    status = fromValue(Value(changed), copy);
+    QVERIFY(status.error == BindingError::TypeMismatch);
+    QCOMPARE(QString(status.field), QString("defines"));
+
+    changed = object;
+    changed["lines"] = QString("1, 2, 3");
+    status = fromValue(Value(changed), copy);
+    QVERIFY(status.error == BindingError::NotAnArray);
+    QCOMPARE(QString(status.field), QString("lines"));
+
+    // only numbers the member represents exactly are converted
+    changed = object;
+    changed["size"] = 3.;
+    QVERIFY(fromValue(Value(changed), copy).ok());
+    QCOMPARE(copy.size, int64_t(3));
+    for (const Value &inexact: {Value(2.5), Value(1e30), Value(std::nan("")),
+                                Value(uint64_t(INT64_MAX) + 1)}) {
+        changed["size"] = inexact;
+        status = fromValue(Value(changed), copy);
+        QVERIFY(status.error == BindingError::OutOfRange);
+        QCOMPARE(QString(status.field), QString("size"));
+    }
+    changed = object;
+    changed["lines"].get<Array>()[1] = int64_t(1) << 40;
+    status = fromValue(Value(changed), copy);
+    QVERIFY(status.error == BindingError::OutOfRange);
+    QCOMPARE(QString(status.field), QString("lines"));
+    changed = object;
+    changed["language"] = uint32_t(1) << 31;
+    QVERIFY(fromValue(Value(changed), copy).error == BindingError::OutOfRange);
+
+    QVERIFY(fromValue(Value(42), copy).error == BindingError::NotAnObject);
+}
+
+void TestValue::testShapedObject()
+{
+    ShapedObject first{{"path", QString("a.cpp")}, {"size", 10}};
+    ShapedObject second{{"path", QString("b.cpp")}, {"size", 20}};
+    QCOMPARE(&first.shape(), &second.shape());
+    QCOMPARE(first.shape().size(), size_t(2));
+    QCOMPARE(first.value("path").value<QString>(), QString("a.cpp"));
+    QCOMPARE(second.value<int>("size"), 20);
+    QCOMPARE(first.value<int>("missing", 42), 42);
+    QVERIFY(first.contains("size"));
+    QVERIFY(!first.contains("missing"));
+    QVERIFY(first.find("missing") == first.end());
+    QVERIFY(first != second);
+
+    QVERIFY(!first.insert({"size", 11}));
+    QCOMPARE(first.at("size"), Value(10));
+    first["size"] = 11;
+    QCOMPARE(first.at("size"), Value(11));
+
+    // adding keys in the same order reuses the cached transitions
+    first["flags"] = QStringList{"-O2"};
+    second.insert({"flags", QStringList{"-O0"}});
+    QCOMPARE(&first.shape(), &second.shape());
+    QCOMPARE(first.shape().parent(), second.shape().parent());
+
+    QCOMPARE(first.erase("size"), size_t(1));
+    QCOMPARE(first.erase("size"), size_t(0));
+    QCOMPARE(first.size(), size_t(2));
+    QCOMPARE(first.at("flags"), Value(QStringList{"-O2"}));
+    QCOMPARE(&first.shape(), Shape::fromKeys({"path", "flags"}).get());
+
+    ShapeCache cache;
+    for (const auto *object: {&first, &second, &first}) {
+        QCOMPARE(object->at("path", cache), object->at("path"));
+        QCOMPARE(cache.shape, &object->shape());
+        QCOMPARE(object->shape().key(cache.slot), QString("path"));
+    }
+    QVERIFY(first.find("missing", cache) == first.end());
+    QCOMPARE(cache.shape, &first.shape());
+
+    // Objects built the same way hit the hinted position, others fall back to a plain lookup
+    const Object firstObject = first.toObject();
+    const Object secondObject = second.toObject();
+    Object reordered;
+    reordered.insert({"flags", QStringList{"-O1"}});
+    reordered.insert({"path", QString("c.cpp")});
+    LookupHint hint;
+    const Object *const objects[] = {&firstObject, &secondObject, &reordered, &firstObject};
+    for (const auto *object: objects) {
+        QCOMPARE(object->at("path", hint), object->at("path"));
+        QCOMPARE(object->find("flags", hint)->second, object->at("flags"));
+    }
+    QVERIFY(reordered.find("missing", hint) == reordered.cend());
+    QVERIFY_EXCEPTION_THROWN(reordered.at("missing", hint), std::out_of_range);
+
+    Object object;
+    for (int i = 0; i < 20; ++i)
+        object.insert({QString::number(i), i});
+    const ShapedObject shaped(object);
+    QCOMPARE(shaped.size(), object.size());
+    for (int i = 0; i < 20; ++i)
+        QCOMPARE(shaped.value<int>(QString::number(i)), i);
+    QCOMPARE(shaped.toObject(), object);
+    QCOMPARE(ShapedObject(shaped.toObject()), shaped);
+
+    size_t count = 0;
+    for (const auto item: shaped) {
+        QCOMPARE(object.at(item.first), item.second);
+        ++count;
+    }
+    QCOMPARE(count, shaped.size());
+
+    // shapes branching off a long chain, or recreated after expiring, keep their own keys
+    QStringList keys;
+    for (int i = 0; i < 40; ++i)
+        keys.append("key" + QString::number(i));
+    const auto chain = Shape::fromKeys(keys);
+    auto branch = Shape::empty();
+    for (int i = 0; i < 20; ++i)
+        branch = branch->withKey(keys.at(i));
+    for (int i = 0; i < 40; ++i) {
+        const auto key = "branch" + QString::number(i);
+        branch = branch->withKey(key);
+        QCOMPARE(branch->slot(key), size_t(20 + i));
+        QCOMPARE(chain->slot(key), Shape::npos);
+    }
+    for (int i = 0; i < 40; ++i) {
+        QCOMPARE(chain->slot(keys.at(i)), size_t(i));
+        QCOMPARE(branch->slot(keys.at(i)), i < 20 ? size_t(i) : Shape::npos);
+    }
+    QCOMPARE(chain->keys(), keys);
+    QCOMPARE(branch->key(20), QString("branch0"));
+    for (int i = 0; i < 100; ++i) {
+        const auto key = "temporary" + QString::number(i % 3);
+        const auto temporary = chain->withKey(key);
+        QCOMPARE(temporary->slot(key), size_t(40));
+        QCOMPARE(temporary->key(39), keys.at(39));
+    }
+}
+
+void TestValue::testCompactString()
+{
+    const CompactString empty;
+    QVERIFY(empty.isEmpty());
+    QVERIFY(empty.isInline());
+    QCOMPARE(empty.toQString(), QString());
+    QVERIFY(empty == QString());
+
+    const QString shortText("compiler");
+    const QString longText("a rather long value that does not fit inline");
+    const QString unicodeText = QString::fromUtf8("\xd0\xba\xd0\xbb\xd1\x8e\xd1\x87 \xf0\x9f\x94\x91");
+    // long enough to be decoded in several pieces, with surrogate pairs across the seams
+    QString longUnicodeText;
+    for (int i = 0; i < 100; ++i)
+        longUnicodeText += unicodeText;
+    for (const auto &text: {shortText, longText, unicodeText, longText + unicodeText, longUnicodeText}) {
+        const CompactString compact(text);
+        QCOMPARE(compact.toQString(), text);
+        QVERIFY(compact == text);
+        QVERIFY(text == compact);
+        QVERIFY(compact != QString(text + "x"));
+        QVERIFY(compact != text.left(text.size() - 1));
+        QCOMPARE(compact.hash(), StringKernels::hash(text));
+        QCOMPARE(compact.hash(42), StringKernels::hash(text, 42));
+        QCOMPARE(CompactString(compact.toUtf8().constData(), size_t(compact.toUtf8().size())),
+                 compact);
+        QCOMPARE(StringKeyHash()(compact), StringKeyHash()(QStringView(text)));
+        QVERIFY(StringKeyEqual()(compact, QStringView(text)));
+        QCOMPARE(compact.isAscii(), text == shortText || text == longText);
+
+        CompactString copy = compact;
+        QCOMPARE(copy, compact);
+        CompactString moved = std::move(copy);
+        QCOMPARE(moved, compact);
+        QVERIFY(copy.isEmpty());
+        copy = moved;
+        QCOMPARE(copy, compact);
+
+        const Value string(text);
+        const Value value(compact);
+        QCOMPARE(value.type(), Value::Type::CompactString);
+        QCOMPARE(value, string);
+        QCOMPARE(string, value);
+        QCOMPARE(std::hash<Value>()(value), std::hash<Value>()(string));
+        QCOMPARE(value.value<QString>(), text);
+        QCOMPARE(string.value<CompactString>(), compact);
+        QCOMPARE(Value::fromQVariant(value.toQVariant()), string);
+    }
+    QVERIFY(CompactString(shortText).isInline());
+    QVERIFY(!CompactString(longText).isInline());
+    QCOMPARE(sizeof(CompactString), size_t(24));
+    QVERIFY(CompactString("a") < CompactString("b"));
+    QVERIFY(CompactString("a") < CompactString("ab"));
+    // like QString, characters above U+FFFF sort before U+E000 to U+FFFF
+    const CompactString replacement("\xef\xbf\xbd");
+    const CompactString key("\xf0\x9f\x94\x91");
+    QVERIFY(key < replacement);
+    QVERIFY(!(replacement < key));
+    QVERIFY(CompactString("z") < CompactString("\xc3\xa9"));
+
+    // invalid UTF-8 becomes the text QString::fromUtf8() makes of it
+    for (const char *bytes: {"\xff", "a\xc0\xaf", "\xed\xa0\x80", "\xe2\x82", "\xf4\x90\x80\x80"}) {
+        const CompactString compact(bytes);
+        const QString text = QString::fromUtf8(bytes);
+        QCOMPARE(compact.toQString(), text);
+        QVERIFY(compact == text);
+        QCOMPARE(compact.hash(), StringKernels::hash(text));
+    }
+    QVERIFY(Value(CompactString("a")) != Value(QString("b")));
+    QVERIFY(Value(CompactString("1")) != Value(1));
+
+    Object object;
+    object.insert({Object::Key("key"), CompactString("value")});
+    QCOMPARE(object.value("key").value<QString>(), QString("value"));
+    QCOMPARE(object.value("key"), Value(QString("value")));
+
+    // lookups by QString and QStringView do not build a key
+    const QString key16("key");
+    QVERIFY(object.find(key16) != object.cend());
+    QVERIFY(object.contains(QStringView(key16)));
+    QVERIFY(!object.contains(QStringView(shortText)));
+    QCOMPARE(object.at(key16), Value(QString("value")));
+    QCOMPARE(object.value<QString>(QStringView(key16)), QString("value"));
+    QCOMPARE(object.value<int>(shortText, 42), 42);
+}
+
+void TestValue::testCompactStringMemory()
+{
+    // Heap usage of the string payloads of a realistic configuration. QString stores UTF-16
+    // in a separately allocated block with a header, CompactString keeps short values inline.
+    const int files = 1000;
+    size_t stringBytes = 0;
+    size_t compactBytes = 0;
+    for (int file = 0; file < files; ++file) {
+        for (const auto &value: configStrings(file)) {
+            stringBytes += sizeof(QString) + 16 + size_t(value.size() + 1) * sizeof(QChar);
+            compactBytes += sizeof(CompactString) + CompactString(value).heapSize();
+        }
+    }
+    qDebug() << "QString:" << stringBytes << "bytes, CompactString:" << compactBytes << "bytes";
+    QVERIFY(compactBytes * 2 < stringBytes);
+
+    QCOMPARE(makeConfig<CompactString>(10), makeConfig<QString>(10));
+}
+
+void TestValue::testValuePool()
+{
+    Array array;
+    array.append(1);
+    Array copy = array;
+    QVERIFY(copy.isSharedWith(array));
+    copy.append(2);
+    QVERIFY(!copy.isSharedWith(array));
+    QCOMPARE(array.size(), size_t(1));
+    const Array moved = std::move(copy);
+    QCOMPARE(moved.size(), size_t(2));
+    QVERIFY(copy.isEmpty());
+    QCOMPARE(copy, Array());
+
+    ValuePool pool;
+    const auto graph = makeBuildGraph(100);
+    const auto interned = pool.intern(Value(graph));
+    QCOMPARE(interned, Value(graph));
+
+    const auto objects = pool.statistics(Value::Type::Object);
+    QCOMPARE(objects.values, size_t(200));
+    QCOMPARE(objects.unique, size_t(104));
+    const auto lists = pool.statistics(Value::Type::StringList);
+    QCOMPARE(lists.values, size_t(100));
+    QCOMPARE(lists.unique, size_t(4));
+    QCOMPARE(lists.ratio(), 25.);
+    QCOMPARE(pool.statistics(Value::Type::Array).unique, size_t(5));
+    QVERIFY(pool.statistics().ratio() > 3);
+    QVERIFY(pool.report().contains("StringList: 100 values, 4 unique, ratio 25.00"));
+    QVERIFY(pool.report().contains("Total"));
+
+    QCOMPARE(pool.intern(Value(graph)), interned);
+    QVERIFY(pool.intern(Value(graph)).isSharedWith(interned));
+
+    // equal subtrees of different records share the canonical instance
+    const auto &records = interned.get<Array>();
+    const auto &first = records.at(0).get<Object>();
+    const auto &fifth = records.at(4).get<Object>();
+    QVERIFY(first.at("options").isSharedWith(fifth.at("options")));
+    QVERIFY(first.at("flags").get<QStringList>() == fifth.at("flags").get<QStringList>());
+    QVERIFY(!first.at("options").isSharedWith(records.at(1).get<Object>().at("options")));
+    QVERIFY(!first.at("path").isSharedWith(fifth.at("path")));
+    QVERIFY(!Value(1).isSharedWith(Value(1)));
+
+    // modifying a canonical value detaches it, the pool is not affected
+    auto modified = interned;
+    modified.get<Array>()[0].get<Object>()["path"] = QString("changed.cpp");
+    QVERIFY(modified != interned);
+    QCOMPARE(pool.intern(Value(graph)), Value(graph));
+    QVERIFY(pool.intern(Value(graph)).isSharedWith(interned));
+
+    Array strings;
+    strings.append(CompactString("a compact string long enough to allocate"));
+    strings.append(CompactString("a compact string long enough to allocate"));
+    strings.append(CompactString("short"));
+    pool.intern(strings);
+    QCOMPARE(pool.statistics(Value::Type::CompactString).values, size_t(2));
+    QCOMPARE(pool.statistics(Value::Type::CompactString).unique, size_t(1));
+
+    // interning keeps the key order of each object
+    Object ab;
+    ab.insert({"a", 2});
+    ab.insert({"b", 1});
+    Object ba;
+    ba.insert({"b", 1});
+    ba.insert({"a", 2});
+    const auto internedAb = pool.intern(ab);
+    const auto internedBa = pool.intern(ba);
+#if !defined(RECURSIVEVARIANT_UNORDERED_OBJECTS)
+    QCOMPARE(toQString(internedAb.begin()->first), QString("a"));
+    QCOMPARE(toQString(internedBa.begin()->first), QString("b"));
+    QVERIFY(!internedBa.isSharedWith(internedAb));
+#endif
+    QVERIFY(pool.intern(ba).isSharedWith(internedBa));
+
+    const auto size = pool.size();
+    QVERIFY(size > 0);
+    pool.clear();
+    QCOMPARE(pool.size(), size_t(0));
+    QCOMPARE(pool.statistics().values, size_t(0));
+    QCOMPARE(interned.get<Array>().size(), size_t(100));
+}
+
+void TestValue::testImplicitSharing()
+{
+    Array array;
+    array.append(1);
+    array.append(QString("two"));
+    Array copy = array;
+    QVERIFY(copy.isSharedWith(array));
+
+    // const access keeps sharing, non-const access detaches even without writing
+    const Array &constCopy = copy;
+    QCOMPARE(constCopy[0], Value(1));
+    QVERIFY(constCopy.begin() != constCopy.end());
+    QVERIFY(copy.isSharedWith(array));
+    QVERIFY(copy.begin() != copy.end());
+    QVERIFY(!copy.isSharedWith(array));
+    QCOMPARE(copy, array);
+
+    // writes through references never reach the other copies
+    Array other = array;
+    Value &first = other[0];
+    first = 3;
+    copy.append(4);
+    QCOMPARE(array[0], Value(1));
+    QCOMPARE(array.size(), size_t(2));
+    QCOMPARE(other[0], Value(3));
+    QCOMPARE(copy.size(), size_t(3));
+
+    Object object;
+    object.insert({"list", array});
+    object.insert({"name", QString("object")});
+    Object objectCopy = object;
+    QVERIFY(objectCopy.isSharedWith(object));
+    QCOMPARE(objectCopy.at("name"), Value(QString("object")));
+    QVERIFY(objectCopy.isSharedWith(object));
+    objectCopy["name"] = QString("copy");
+    QVERIFY(!objectCopy.isSharedWith(object));
+    QCOMPARE(object.at("name"), Value(QString("object")));
+
+    // nested containers are shared too, modifying them through a copy detaches each level
+    QVERIFY(objectCopy.at("list").isSharedWith(object.at("list")));
+    objectCopy["list"].get<Array>().append(5);
+    QCOMPARE(object.at("list"), Value(array));
+    QCOMPARE(objectCopy.at("list").get<Array>().size(), size_t(3));
+
+    const Value value(object);
+    Value valueCopy = value;
+    QVERIFY(valueCopy.isSharedWith(value));
+    valueCopy.get<Object>().erase(Object::Key("list"));
+    QVERIFY(!valueCopy.isSharedWith(value));
+    QCOMPARE(value.get<Object>().size(), size_t(2));
+
+    // default-constructed and moved-from containers are empty and usable
+    QCOMPARE(Array(), Array());
+    QCOMPARE(Object(), Object());
+    Array moved = std::move(copy);
+    QCOMPARE(moved.size(), size_t(3));
+    QVERIFY(copy.empty());
+    copy.append(6);
+    QCOMPARE(copy.size(), size_t(1));
+    Object movedObject = std::move(objectCopy);
+    QCOMPARE(movedObject.size(), size_t(2));
+    QVERIFY(objectCopy.empty());
+    QVERIFY(objectCopy.find(Object::Key("name")) == objectCopy.cend());
+    objectCopy["name"] = 7;
+    QCOMPARE(objectCopy.size(), size_t(1));
+}
+
+void TestValue::testOrderedHashMap()
+{
+    using Map = OrderedHashMap<QString, int, StringKeyHash, StringKeyEqual>;
+    const auto keys = [](const Map &map) {
+        QStringList result;
+        for (const auto &item: map)
+            result.append(item.first);
+        return result;
+    };
+
+    for (const int count: {5, 100}) {
+        Map map;
+        QStringList expected;
+        for (int i = count - 1; i >= 0; --i) {
+            QVERIFY(map.insert({QString::number(i), i}).second);
+            expected.append(QString::number(i));
+        }
+        QVERIFY(!map.insert({"0", 42}).second);
+        QCOMPARE(map.size(), size_t(count));
+        QCOMPARE(keys(map), expected);
+        for (int i = 0; i < count; ++i)
+            QCOMPARE(map.at(QString::number(i)), i);
+        QVERIFY(map.find("missing") == map.end());
+        QCOMPARE(map.count("missing"), size_t(0));
+
+        // erasing leaves tombstones, iteration and lookups skip them
+        QCOMPARE(map.erase(QString::number(count - 1)), size_t(1));
+        QCOMPARE(map.erase(QString::number(count - 1)), size_t(0));
+        expected.removeFirst();
+        QCOMPARE(keys(map), expected);
+        map["new"] = -1;
+        expected.append("new");
+        QCOMPARE(keys(map), expected);
+
+        // erasing every other element compacts on the way, the returned iterators stay valid
+        bool erase = true;
+        for (auto it = map.begin(); it != map.end(); erase = !erase) {
+            if (erase)
+                it = map.erase(it);
+            else
+                ++it;
+        }
+        QStringList remaining;
+        for (qsizetype i = 1; i < expected.size(); i += 2)
+            remaining.append(expected.at(i));
+        QCOMPARE(keys(map), remaining);
+        QCOMPARE(map.size(), size_t(remaining.size()));
+        for (const auto &key: remaining)
+            QVERIFY(map.find(key) != map.end());
+        for (const auto &key: expected)
+            QCOMPARE(map.count(key), size_t(remaining.contains(key) ? 1 : 0));
+
+        Map reversed;
+        for (auto it = remaining.rbegin(); it != remaining.rend(); ++it)
+            reversed.insert({*it, map.at(*it)});
+        QVERIFY(reversed == map);
+        reversed["other"] = 1;
+        QVERIFY(reversed != map);
+
+        // copies keep the order and the tombstones' effect on it
+        Map copy = map;
+        QCOMPARE(keys(copy), remaining);
+        copy["copied"] = 1;
+        QCOMPARE(keys(map), remaining);
+        Map moved = std::move(copy);
+        QCOMPARE(moved.size(), size_t(remaining.size() + 1));
+        QCOMPARE(moved.at("copied"), 1);
+    }
+
+    // like std::unordered_map, insertion does not move the existing elements
+    {
+        Map map;
+        map["b"] = 7;
+        const int &b = map["b"];
+        for (int i = 0; i < 1000; ++i)
+            map[QString::number(i)] = map["b"];
+        QCOMPARE(&map["b"], &b);
+        QCOMPARE(b, 7);
+        QCOMPARE(map.at("999"), 7);
+
+        // erased entries are reused, the others stay in place
+        for (int i = 0; i < 1000; i += 2)
+            map.erase(QString::number(i));
+        for (int i = 0; i < 1000; i += 2)
+            map[QString::number(i + 1000)] = i;
+        QCOMPARE(&map["b"], &b);
+        QCOMPARE(map.size(), size_t(1001));
+        QCOMPARE(map.at("1998"), 998);
+    }
+
+#if !defined(RECURSIVEVARIANT_UNORDERED_OBJECTS)
+    Object object;
+    QStringList expected;
+    for (int i = 0; i < 50; ++i) {
+        const auto key = makeKey(i % 16 + 1, i);
+        object.insert({key, i});
+        expected.append(key);
+    }
+    QStringList actual;
+    for (const auto &item: object)
+        actual.append(toQString(item.first));
+    QCOMPARE(actual, expected);
+#endif
+}
+
+void TestValue::testReclaimer()
+{
+    // the array and 13 nodes per record
+    const size_t graphNodes = 1 + 13 * 100;
+    Reclaimer reclaimer(100, 4 * graphNodes);
+    QCOMPARE(reclaimer.threshold(), size_t(100));
+    QCOMPARE(reclaimer.nodeBudget(), 4 * graphNodes);
+
+    QVERIFY(!reclaimer.release(Value(42)));
+    QVERIFY(!reclaimer.release(Value(makeBuildGraph(2))));
+    QVERIFY(reclaimer.release(Value(makeBuildGraph(100))));
+    reclaimer.flush();
+    QCOMPARE(reclaimer.pending(), size_t(0));
+    QCOMPARE(reclaimer.statistics().deferred, size_t(1));
+    QCOMPARE(reclaimer.statistics().synchronous, size_t(2));
+
+    // releasing a shared copy leaves the other owner intact
+    const Value graph(makeBuildGraph(100));
+    QVERIFY(reclaimer.release(graph));
+    reclaimer.flush();
+    QCOMPARE(graph, Value(makeBuildGraph(100)));
+
+    // the queue is bounded by its nodes, the releases it does not take are synchronous
+    for (int i = 0; i < 50; ++i)
+        reclaimer.release(Value(makeBuildGraph(100)));
+    reclaimer.flush();
+    const auto statistics = reclaimer.statistics();
+    QCOMPARE(statistics.deferred + statistics.synchronous, size_t(54));
+    QVERIFY(!reclaimer.release(Value(makeBuildGraph(1000))));
+
+    Value value(makeBuildGraph(2000));
+    value.releaseAsync();
+    QVERIFY(value.isNull());
+    Reclaimer::instance().flush();
+    QCOMPARE(Reclaimer::instance().pending(), size_t(0));
+}
+
+void TestValue::testChangeTracker()
+{
+    const Value graph(makeBuildGraph(10));
+    ChangeTracker tracker(graph);
+    QCOMPARE(tracker.version(), uint64_t(0));
+    QVERIFY(!tracker.hasChanges());
+
+    // changing a node bumps it and its ancestors, siblings keep their versions
+    tracker.set({3, "path"}, QString("src/renamed.cpp"));
+    QCOMPARE(tracker.root().get<Array>().at(3).get<Object>().at("path"),
+             Value(QString("src/renamed.cpp")));
+    QCOMPARE(graph.get<Array>().at(3).get<Object>().at("path"),
+             Value(QString("src/file3.cpp")));
+    const auto first = tracker.version({3, "path"});
+    QVERIFY(first > 0);
+    QCOMPARE(tracker.version({3}), first);
+    QCOMPARE(tracker.version(), first);
+    QCOMPARE(tracker.version({2}), uint64_t(0));
+    QCOMPARE(tracker.version({3, "options"}), uint64_t(0));
+    QCOMPARE(tracker.version({3, "options", "defines", 0}), uint64_t(0));
+
+    tracker.append({3, "options", "defines"}, QString("EXTRA"));
+    QVERIFY(tracker.insert({3, "options"}, "lto", true));
+    QVERIFY(!tracker.insert({3, "options"}, "lto", false));
+    QCOMPARE(tracker.erase({3, "options"}, "compiler"), size_t(1));
+    QCOMPARE(tracker.erase({3, "options"}, "compiler"), size_t(0));
+    QVERIFY(tracker.version({3, "options", "defines"}) > first);
+    QVERIFY(tracker.version({3, "options", "compiler"}) > tracker.version({3, "options", "lto"}));
+    QCOMPARE(tracker.version({3, "options", "defines", 0}), uint64_t(0));
+    QVERIFY(tracker.version({3, "options", "defines", 2}) > first);
+    QCOMPARE(tracker.version({3, "path"}), first);
+    QCOMPARE(tracker.version({3}), tracker.version({3, "options"}));
+    QCOMPARE(tracker.root().get<Array>().at(3).get<Object>().at("options").get<Object>().size(),
+             size_t(4));
+
+    const auto changes = tracker.takeChanges();
+    QCOMPARE(changes.size(), size_t(4));
+    QCOMPARE(changes.at(0).toString(), QString("/3/path"));
+    QCOMPARE(changes.at(1).toString(), QString("/3/options/defines/2"));
+    QCOMPARE(changes.at(2).toString(), QString("/3/options/lto"));
+    QCOMPARE(changes.at(3).toString(), QString("/3/options/compiler"));
+    QVERIFY(!tracker.hasChanges());
+
+    // the log keeps only the topmost changed paths
+    tracker.set({5, "path"}, QString("a.cpp"));
+    tracker.edit({5}).get<Object>().insert({"size", 10});
+    tracker.set({5, "flags"}, QStringList());
+    tracker.set({6, "path"}, QString("b.cpp"));
+    const auto compacted = tracker.takeChanges();
+    QCOMPARE(compacted.size(), size_t(2));
+    QVERIFY(compacted.at(0) == ValuePath({5}));
+    QVERIFY(compacted.at(1) == ValuePath({6, "path"}));
+    QVERIFY(tracker.version({5, "options"}) > tracker.version({3}));
+
+    // inserting into an array changes the elements after the insertion point
+    const auto before = tracker.version({8});
+    tracker.insert({}, 7, Value());
+    QCOMPARE(tracker.version({6, "path"}), tracker.version({6}));
+    QVERIFY(tracker.version({6}) < tracker.version({8}));
+    QVERIFY(tracker.version({8}) > before);
+    QVERIFY(tracker.version({10, "options"}) > before);
+    QCOMPARE(tracker.root().get<Array>().size(), size_t(11));
+    QVERIFY(tracker.takeChanges().at(0).isEmpty());
+
+    // listeners see every change, the log only the topmost ones, in the order of the first
+    std::vector<QString> notified;
+    const auto listener = tracker.addListener([&notified](const ValuePath &path) {
+        notified.push_back(path.toString());
+    });
+    tracker.set({2, "path"}, QString("c.cpp"));
+    tracker.insert({2}, "size", 1);
+    tracker.set({2}, Object());
+    tracker.set({1, "path"}, QString("d.cpp"));
+    tracker.set({2}, Array());
+    tracker.removeListener(listener);
+    tracker.set({0, "path"}, QString("e.cpp"));
+    QCOMPARE(notified, (std::vector<QString>{"/2/path", "/2/size", "/2", "/1/path", "/2"}));
+    const auto logged = tracker.takeChanges();
+    QCOMPARE(logged.size(), size_t(3));
+    QCOMPARE(logged.at(0).toString(), QString("/2"));
+    QCOMPARE(logged.at(1).toString(), QString("/1/path"));
+    QCOMPARE(logged.at(2).toString(), QString("/0/path"));
+
+    for (int i = 0; i < 1000; ++i)
+        tracker.append({2}, i);
+    const auto appended = tracker.takeChanges();
+    QCOMPARE(appended.size(), size_t(1000));
+    QVERIFY(appended.at(999) == ValuePath({2, 999}));
+    QCOMPARE(tracker.version({2, 999}), tracker.version({2}));
+
+    // appending leaves the versions of the earlier elements alone, also after an insertion
+    const auto firstAppended = tracker.version({2, 0});
+    QVERIFY(firstAppended < tracker.version({2, 1}));
+    tracker.insert({2}, 500, -1);
+    const auto shifted = tracker.version({2, 600});
+    tracker.append({2}, 1000);
+    tracker.append({2}, 1001);
+    QCOMPARE(tracker.version({2, 0}), firstAppended);
+    QVERIFY(tracker.version({2, 499}) < shifted);
+    QCOMPARE(tracker.version({2, 600}), shifted);
+    QVERIFY(tracker.version({2, 1001}) > shifted);
+    QVERIFY(tracker.version({2, 1002}) > tracker.version({2, 1001}));
+    QCOMPARE(tracker.version({2, 1002}), tracker.version({2}));
+    tracker.takeChanges();
+
+    for (const auto &missing: {ValuePath({42}), ValuePath({1, "missing"}), ValuePath({1, 0})}) {
+        try {
+            tracker.edit(missing);
+            QVERIFY2(false, "Editing a missing path should throw");
+        } catch (const std::out_of_range &) {
+        }
+    }
+    try {
+        tracker.append({1}, 1);
+        QVERIFY2(false, "Appending to an Object should throw");
+    } catch (const std::out_of_range &) {
+    }
+    QVERIFY(!tracker.hasChanges());
+
+    QCOMPARE(ValuePath({"a/b", "c~d", 1}).toString(), QString("/a~1b/c~0d/1"));
+    QVERIFY(ValuePath({1, "a"}).startsWith({1}));
+    QVERIFY(!ValuePath({1}).startsWith({1, "a"}));
+}
+
+// Parses the input fed in chunks of the given size
+static Value parseChunked(PushParser::Format format, const QByteArray &input, qsizetype chunk)
+{
+    PushParser parser(format);
+    for (qsizetype pos = 0; pos < input.size(); pos += chunk)
+        parser.feed(QByteArrayView(input.constData() + pos, std::min(chunk, input.size() - pos)));
+    if (parser.finish() != PushParser::Status::Complete)
+        return QString("error: ") + parser.errorString();
+    return parser.takeValue();
+}
+
+// Records the events as text
+class EventLog : public PushParser::Handler
+{
+public:
+    void startObject() override { events += "{"; }
+    void endObject() override { events += "}"; }
+    void startArray() override { events += "["; }
+    void endArray() override { events += "]"; }
+    void key(const QString &key) override { events += key + ":"; }
+    void value(Value value) override { events += QString::number(int(value.type())) + ","; }
+
+    QString events;
+};
+
+// Counts the items of string lists and typed arrays, which arrive in pieces
+class ItemCounter : public EventLog
+{
+public:
+    void startItems(Value::Type type, uint64_t count) override
+    {
+        events += QString::number(int(type)) + "(" + QString::number(qint64(count)) + ")";
+    }
+    void items(const Value &items) override
+    {
+        const size_t size = items.type() == Value::Type::DoubleArray
+                ? items.get<DoubleArray>().size()
+                : size_t(items.get<Int64Array>().size());
+        received += size;
+        largest = std::max(largest, size);
+        sum += items.type() == Value::Type::DoubleArray ? items.get<DoubleArray>().sum() : 0.;
+    }
+    void endItems() override { events += ","; }
+
+    size_t received{0};
+    size_t largest{0};
+    double sum{0};
+};
+
+void TestValue::testPushParser()
+{
+    const QByteArray json(" {\"name\": \"caf\\u00e9 \\ud83d\\ude00 \\ud800\", \"list\": [1, -2, 3000000000,"
+                          " 18446744073709551615, 1.5e2, -0.25, true, false, null, []],"
+                          " \"empty\": {}, \"escapes\": \"a\\\"b\\\\c\\n\\/\", \"name\": \"last\"} ");
+    Array list;
+    list.append(1);
+    list.append(-2);
+    list.append(int64_t(3000000000));
+    list.append(uint64_t(18446744073709551615u));
+    list.append(150.);
+    list.append(-0.25);
+    list.append(true);
+    list.append(false);
+    list.append(Value());
+    list.append(Array());
+    Object expected;
+    expected.insert({"name", QString("last")});
+    expected.insert({"list", list});
+    expected.insert({"empty", Object()});
+    expected.insert({"escapes", QString("a\"b\\c\n/")});
+
+    // a token split between chunks is resumed
+    for (qsizetype chunk = 1; chunk <= json.size(); ++chunk)
+        QCOMPARE(parseChunked(PushParser::Format::Json, json, chunk), Value(expected));
+
+    Object strings;
+    strings.insert({"s", QString::fromUtf8("caf\xc3\xa9 \xf0\x9f\x98\x80 \xef\xbf\xbd")});
+    QCOMPARE(parseChunked(PushParser::Format::Json, "{\"s\": \"caf\\u00e9 \\ud83d\\ude00 \\ud800\"}", 3),
+             Value(strings));
+    QCOMPARE(parseChunked(PushParser::Format::Json, "-12", 1), Value(-12));
+    QCOMPARE(parseChunked(PushParser::Format::Json, "1e400", 5).type(), Value::Type::Double);
+
+    // errors report the offset of the offending byte
+    const std::pair<QByteArray, qint64> errors[] = {
+        {"[1, 2,]", 6},
+        {"{\"a\" 1}", 5},
+        {"[01]", 1},
+        {"[1.]", 1},
+        {"tru", 3},
+        {"trve", 2},
+        {"\"a\\x\"", 3},
+        {"[1] 2", 4},
+        {"{\"a\": [1, 2}", 11},
+        {"\"\n\"", 1},
+    };
+    for (const auto &[input, offset]: errors) {
+        PushParser parser;
+        for (qsizetype pos = 0; pos < input.size(); ++pos)
+            parser.feed(QByteArrayView(input.constData() + pos, 1));
+        QCOMPARE(parser.finish(), PushParser::Status::Error);
+        QCOMPARE(parser.errorOffset(), offset);
+        QVERIFY(!parser.errorString().isEmpty());
+        QVERIFY(parser.takeValue().isNull());
+    }
+
+    PushParser parser;
+    QCOMPARE(parser.feed("[1, "), PushParser::Status::Incomplete);
+    QVERIFY(parser.takeValue().isNull());
+    QCOMPARE(parser.feed("2]"), PushParser::Status::Complete);
+    QCOMPARE(parser.takeValue().get<Array>().size(), size_t(2));
+    parser.reset();
+    parser.setMaxDepth(3);
+    QCOMPARE(parser.feed("[[[]]]"), PushParser::Status::Complete);
+    parser.reset();
+    QCOMPARE(parser.feed("[[[[]]]]"), PushParser::Status::Error);
+    QCOMPARE(parser.errorOffset(), qint64(3));
+
+    // event mode
+    EventLog log;
+    PushParser events(PushParser::Format::Json, log);
+    QCOMPARE(events.feed("{\"a\": [1, \"x\"], \"b\": {\"c\": null}}"), PushParser::Status::Complete);
+    QCOMPARE(log.events, QString("{a:[2,7,]b:{c:0,}}"));
+    QVERIFY(events.takeValue().isNull());
+
+    // binary encoding of every type, fed in chunks of all sizes
+    Object all;
+    all.insert({"null", Value()});
+    all.insert({"bool", true});
+    all.insert({"int32", -7});
+    all.insert({"uint32", uint32_t(4000000000u)});
+    all.insert({"int64", int64_t(-5000000000)});
+    all.insert({"uint64", uint64_t(18000000000000000000u)});
+    all.insert({"double", 2.5});
+    all.insert({"string", QString::fromUtf8("\xc3\xa9t\xc3\xa9")});
+    all.insert({"empty", QString()});
+    all.insert({"compact", CompactString(QString("compact"))});
+    all.insert({"list", QStringList{"a", "", "c"}});
+    all.insert({"doubles", DoubleArray({1.5, -2.})});
+    all.insert({"ints", Int64Array({1, -1, int64_t(1) << 40})});
+    all.insert({"graph", makeBuildGraph(3)});
+    all.insert({"", Object()});
+    const auto binary = toBinary(all);
+    for (qsizetype chunk = 1; chunk <= binary.size(); ++chunk)
+        QCOMPARE(parseChunked(PushParser::Format::Binary, binary, chunk), Value(all));
+    QCOMPARE(parseChunked(PushParser::Format::Binary, toBinary(Value(42)), 1), Value(42));
+
+    EventLog binaryLog;
+    PushParser binaryEvents(PushParser::Format::Binary, binaryLog);
+    Object small;
+    small.insert({"a", makeBuildGraph(1).at(0).get<Object>().value("flags")});
+    QCOMPARE(binaryEvents.feed(toBinary(small)), PushParser::Status::Complete);
+    QCOMPARE(binaryLog.events, QString("{a:[7,7,7,]}"));
+
+    // a large typed array reaches a handler in pieces, the parser does not gather it
+    DoubleArray large;
+    for (int i = 0; i < 1000000; ++i)
+        large.append(i % 7);
+    Object document;
+    document.insert({"samples", large});
+    ItemCounter counter;
+    PushParser streaming(PushParser::Format::Binary, counter);
+    const auto encoded = toBinary(document);
+    for (qsizetype pos = 0; pos < encoded.size(); pos += 65536)
+        streaming.feed(QByteArrayView(encoded.constData() + pos,
+                                      std::min<qsizetype>(65536, encoded.size() - pos)));
+    QCOMPARE(streaming.status(), PushParser::Status::Complete);
+    QCOMPARE(counter.events, QString("{samples:%1(1000000),}").arg(int(Value::Type::DoubleArray)));
+    QCOMPARE(counter.received, size_t(1000000));
+    QVERIFY(counter.largest <= 4096);
+    QCOMPARE(counter.sum, large.sum());
+
+    const std::pair<QByteArray, qint64> binaryErrors[] = {
+        {QByteArray(1, char(99)), 0},
+        {binary + QByteArray(1, char(0)), binary.size()},
+        {QByteArray("\x0a\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01", 12), 11},
+    };
+    for (const auto &[input, offset]: binaryErrors) {
+        PushParser parser(PushParser::Format::Binary);
+        parser.feed(input);
+        QCOMPARE(parser.finish(), PushParser::Status::Error);
+        QCOMPARE(parser.errorOffset(), offset);
+    }
+    PushParser truncated(PushParser::Format::Binary);
+    QCOMPARE(truncated.feed(binary.mid(0, binary.size() - 1)), PushParser::Status::Incomplete);
+    QCOMPARE(truncated.finish(), PushParser::Status::Error);
+}
+
+void TestValue::testConstValue()
+{
+    const ValueView defaults(ConstDefaults::defaults);
+    QCOMPARE(defaults.type(), Value::Type::Object);
+    QCOMPARE(defaults.size(), size_t(7));
+    QCOMPARE(defaults.key(1), std::u16string_view(u"flags"));
+    QCOMPARE(defaults.at(1).size(), size_t(3));
+    QCOMPARE(defaults[u"flags"][2].toString(), QString("-O0"));
+    QCOMPARE(defaults[u"options"][u"defines"][1].toString(), QString("NDEBUG"));
+    QVERIFY(!defaults[u"options"][u"optimize"].toBool(true));
+    QCOMPARE(defaults[u"limits"][u"memory"].toInt64(), int64_t(1) << 34);
+    QCOMPARE(defaults[u"limits"][u"timeout"].toInt64(), int64_t(-1));
+    QCOMPARE(defaults[u"limits"][u"ratio"].toDouble(), 0.75);
+    QCOMPARE(defaults[u"limits"][u"jobs"].toDouble(), 8.);
+    QVERIFY(defaults[u"outputs"].isEmpty());
+    QCOMPARE(defaults[u"outputs"].type(), Value::Type::Array);
+    QCOMPARE(defaults[u"environment"].type(), Value::Type::Object);
+
+    // mismatched and missing lookups give null views
+    QVERIFY(defaults.contains(u"cache"));
+    QVERIFY(defaults[u"cache"].isNull());
+    QVERIFY(!defaults.contains(u"missing"));
+    QVERIFY(defaults[u"missing"][u"deeper"][0].isNull());
+    QVERIFY(defaults[u"flags"][3].isNull());
+    QVERIFY(defaults[0].isNull());
+    QCOMPARE(defaults[u"path"].toInt64(42), int64_t(42));
+    QVERIFY(defaults[u"jobs"].toStringView().empty());
+    QVERIFY(ValueView().isNull());
+
+    QCOMPARE(defaults.toValue(), Value(makeDynamicDefaults()));
+    QCOMPARE(defaults[u"limits"].toValue().type(), Value::Type::Object);
+    QCOMPARE(defaults[u"path"].toValue(), Value(QString("src/file0.cpp")));
+    QVERIFY(defaults[u"missing"].toValue().isNull());
+}
+
+void TestValue::testArrayIndex()
+{
+    // records with mixed numeric types, a nested key and some missing fields
+    Array table;
+    for (int i = 0; i < 100; ++i) {
+        Object group;
+        group.insert({"name", QString("group%1").arg(i % 5)});
+        Object record;
+        record.insert({"id", i});
+        if (i % 10 != 9)
+            record.insert({"group", group});
+        if (i % 3 == 0)
+            record.insert({"size", int64_t(i)});
+        else if (i % 3 == 1)
+            record.insert({"size", double(i) + 0.5});
+        else
+            record.insert({"size", uint32_t(i)});
+        table.append(record);
+    }
+    table.append(42);
+
+    ArrayIndex byGroup(ArrayIndex::Kind::Hash, ValuePath({"group", "name"}));
+    byGroup.rebuild(table);
+    QCOMPARE(byGroup.size(), size_t(90));
+    const auto group2 = byGroup.find(QString("group2"));
+    QCOMPARE(group2.size(), size_t(20));
+    QVERIFY(std::is_sorted(group2.begin(), group2.end()));
+    for (const auto position: group2)
+        QCOMPARE(position % 5, size_t(2));
+    QVERIFY(byGroup.find(QString("group7")).empty());
+    QVERIFY(byGroup.find(2).empty());
+    QCOMPARE(byGroup.findFirst(QString("group3"))->get<Object>().value("id"), Value(3));
+    QVERIFY(!byGroup.findFirst(QString("missing")));
+
+    // composite keys take one value per path
+    ArrayIndex byGroupAndId(ArrayIndex::Kind::Hash, std::vector<ValuePath>{{"group", "name"}, {"id"}});
+    byGroupAndId.rebuild(table);
+    Array key;
+    key.append(QString("group1"));
+    key.append(11);
+    QCOMPARE(byGroupAndId.find(key), std::vector<size_t>{11});
+    key[1] = 12;
+    QVERIFY(byGroupAndId.find(key).empty());
+    QVERIFY(byGroupAndId.find(QString("group1")).empty());
+
+    // a sorted index orders numbers by value whatever their type
+    ArrayIndex bySize(ArrayIndex::Kind::Sorted, ValuePath({"size"}));
+    bySize.rebuild(table);
+    QCOMPARE(bySize.size(), size_t(100));
+    QCOMPARE(bySize.find(30), std::vector<size_t>{30});
+    QCOMPARE(bySize.find(31.5), std::vector<size_t>{31});
+    QCOMPARE(bySize.find(uint64_t(32)), std::vector<size_t>{32});
+    QCOMPARE(bySize.range(10, 14), (std::vector<size_t>{10, 11, 12, 13}));
+    QCOMPARE(bySize.range(int64_t(-5), 2.), (std::vector<size_t>{0, 1}));
+    QCOMPARE(bySize.range(98.75, 1000).size(), size_t(1));
+    QVERIFY(bySize.range(50, 50).empty());
+    QVERIFY(bySize.range(QString("a"), QString("z")).empty());
+    try {
+        byGroup.range(QString("group1"), QString("group3"));
+        QVERIFY2(false, "A range lookup on a hash index should throw");
+    } catch (const std::logic_error &) {
+    }
+
+    QVERIFY(ArrayIndex::compare(Value(), false) < 0);
+    QVERIFY(ArrayIndex::compare(true, -1) < 0);
+    QVERIFY(ArrayIndex::compare(int64_t(-1), uint64_t(0)) < 0);
+    QVERIFY(ArrayIndex::compare(uint64_t(1) << 63, int64_t(-1)) > 0);
+    QCOMPARE(ArrayIndex::compare(3, 3.), 0);
+    QVERIFY(ArrayIndex::compare(QString("a"), CompactString("b")) < 0);
+    QVERIFY(ArrayIndex::compare(1e300, QString()) < 0);
+
+    // strings of either type compare like QString, by UTF-16 code units
+    const QStringList texts{QString(), "a", "ab", "b", QString::fromUtf8("\xc3\xa9"),
+                            QString::fromUtf8("\xef\xbf\xbd"), QString::fromUtf8("\xf0\x9f\x94\x91")};
+    for (const auto &l: texts) {
+        for (const auto &r: texts) {
+            const int expected = l < r ? -1 : r < l ? 1 : 0;
+            const auto sign = [](int i) { return i < 0 ? -1 : i > 0 ? 1 : 0; };
+            QCOMPARE(sign(ArrayIndex::compare(l, r)), expected);
+            QCOMPARE(sign(ArrayIndex::compare(CompactString(l), r)), expected);
+            QCOMPARE(sign(ArrayIndex::compare(l, CompactString(r))), expected);
+            QCOMPARE(sign(ArrayIndex::compare(CompactString(l), CompactString(r))), expected);
+        }
+    }
+
+    // integers compare exactly with doubles, so that the order stays transitive beyond 2^53
+    const int64_t exact = int64_t(1) << 53;
+    QCOMPARE(ArrayIndex::compare(exact, double(exact)), 0);
+    QVERIFY(ArrayIndex::compare(exact + 1, double(exact)) > 0);
+    QVERIFY(ArrayIndex::compare(double(exact), exact + 1) < 0);
+    QVERIFY(ArrayIndex::compare(std::numeric_limits<uint64_t>::max(), 0x1p64) < 0);
+    QCOMPARE(ArrayIndex::compare(std::numeric_limits<int64_t>::min(), -0x1p63), 0);
+    QVERIFY(ArrayIndex::compare(-3, -2.5) < 0);
+    QVERIFY(ArrayIndex::compare(-2, -2.5) > 0);
+    QVERIFY(ArrayIndex::compare(std::numeric_limits<double>::quiet_NaN(), 1e300) > 0);
+    QVERIFY(ArrayIndex::compare(uint64_t(1), std::numeric_limits<double>::quiet_NaN()) < 0);
+
+    // containers are equal only by content
+    Array first;
+    first.append(1);
+    Array second;
+    second.append(2);
+    Array firstAgain;
+    firstAgain.append(1);
+    QCOMPARE(ArrayIndex::compare(first, firstAgain), 0);
+    QVERIFY(ArrayIndex::compare(first, second) != 0);
+    QCOMPARE(ArrayIndex::compare(first, second), -ArrayIndex::compare(second, first));
+
+    // a hash index matches numbers by value like a sorted one
+    ArrayIndex bySizeHash(ArrayIndex::Kind::Hash, ValuePath({"size"}));
+    bySizeHash.rebuild(table);
+    QCOMPARE(bySizeHash.find(30.), std::vector<size_t>{30});
+    QCOMPARE(bySizeHash.find(uint64_t(32)), std::vector<size_t>{32});
+    QCOMPARE(bySizeHash.find(31.5), std::vector<size_t>{31});
+    QVERIFY(bySizeHash.find(31).empty());
+
+    // a multi-threaded rebuild gives the same results
+    Array large;
+    for (int i = 0; i < 20000; ++i) {
+        Object record;
+        record.insert({"key", i % 1000});
+        large.append(record);
+    }
+    ArrayIndex serial(ArrayIndex::Kind::Sorted, ValuePath({"key"}));
+    serial.rebuild(large);
+    ArrayIndex parallel(ArrayIndex::Kind::Sorted, ValuePath({"key"}));
+    parallel.rebuild(large, 4);
+    QCOMPARE(parallel.range(100, 200), serial.range(100, 200));
+    ArrayIndex parallelHash(ArrayIndex::Kind::Hash, ValuePath({"key"}));
+    parallelHash.rebuild(large, 0);
+    QCOMPARE(parallelHash.find(7), serial.find(7));
+    QCOMPARE(parallelHash.find(7).size(), size_t(20));
+
+    // modifying the array makes the index stale, the index keeps its own copy
+    QVERIFY(!byGroup.isStale(table));
+    const Array &constTable = table;
+    QCOMPARE(constTable.at(3).get<Object>().value("id"), Value(3));
+    QVERIFY(!byGroup.isStale(table));
+    table.append(Value());
+    QVERIFY(byGroup.isStale(table));
+    QVERIFY(byGroup.isStale(large));
+    QCOMPARE(byGroup.array().size(), size_t(101));
+    byGroup.rebuild(table);
+    QVERIFY(!byGroup.isStale(table));
+}
+
+void TestValue::testConcurrentObject()
+{
+    ConcurrentObject object(10);
+    QCOMPARE(object.shardCount(), size_t(16));
+    QVERIFY(object.isEmpty());
+    QVERIFY(object.insert({"a", 1}));
+    QVERIFY(!object.insert({"a", 2}));
+    QCOMPARE(object.value("a"), Value(1));
+    QVERIFY(!object.insert_or_assign("a", 3));
+    QVERIFY(object.insert_or_assign("b", QString("b")));
+    QCOMPARE(object.find("a"), std::optional<Value>(3));
+    QVERIFY(!object.find("missing"));
+    QCOMPARE(object.value<QString>("b"), QString("b"));
+    QCOMPARE(object.value<int>("b", 42), 42);
+    QVERIFY(object.contains("b"));
+    QCOMPARE(object.size(), size_t(2));
+    QCOMPARE(object.erase("b"), size_t(1));
+    QCOMPARE(object.erase("b"), size_t(0));
+
+    // compute inserts, updates and erases atomically
+    QCOMPARE(object.compute("c", [](std::optional<Value> &value) {
+        QVERIFY(!value);
+        value = Array();
+    }), std::optional<Value>(Array()));
+    object.compute("c", [](std::optional<Value> &value) { value->get<Array>().append(1); });
+    QCOMPARE(object.value("c").get<Array>().size(), size_t(1));
+    QVERIFY(!object.compute("c", [](std::optional<Value> &value) { value.reset(); }));
+    QVERIFY(!object.contains("c"));
+    try {
+        object.compute("d", [](std::optional<Value> &value) {
+            value = 1;
+            throw std::runtime_error("failed");
+        });
+        QVERIFY2(false, "The exception should propagate");
+    } catch (const std::runtime_error &) {
+    }
+    QVERIFY(!object.contains("d"));
+    // an existing key is erased rather than left with a moved-from value
+    object.insert_or_assign("e", Array());
+    try {
+        object.compute("e", [](std::optional<Value> &value) {
+            const Value moved = std::move(*value);
+            throw std::runtime_error("failed");
+        });
+        QVERIFY2(false, "The exception should propagate");
+    } catch (const std::runtime_error &) {
+    }
+    QVERIFY(!object.contains("e"));
+
+    // concurrent increments from several threads are not lost
+    const int threads = 8;
+    const int increments = 2000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&object, t] {
+            for (int i = 0; i < increments; ++i) {
+                const auto key = QString("counter%1").arg(i % 10);
+                object.compute(key, [](std::optional<Value> &value) {
+                    value = value ? value->get<int>() + 1 : 1;
+                });
+                object.insert_or_assign(QString("thread%1").arg(t), i);
+                object.value(key);
+            }
+        });
+    }
+    for (auto &worker: workers)
+        worker.join();
+    for (int i = 0; i < 10; ++i)
+        QCOMPARE(object.value(QString("counter%1").arg(i)), Value(threads * increments / 10));
+
+    // a snapshot is not affected by later changes
+    const auto snapshot = object.snapshot();
+    QCOMPARE(snapshot.size(), size_t(19));
+    object.insert_or_assign("a", 4);
+    object.erase("counter0");
+    QCOMPARE(snapshot.value("a"), Value(3));
+    QVERIFY(snapshot.contains("counter0"));
+    QVERIFY(!snapshot.contains("missing"));
+    size_t entries = 0;
+    for (const auto &entry: snapshot) {
+        QVERIFY(snapshot.contains(entry.first));
+        ++entries;
+    }
+    QCOMPARE(entries, size_t(19));
+    QCOMPARE(snapshot.toObject().size(), size_t(19));
+    QCOMPARE(snapshot.toObject().value("thread3"), Value(increments - 1));
+
+    object.clear();
+    QVERIFY(object.isEmpty());
+    QCOMPARE(snapshot.size(), size_t(19));
+    const auto empty = object.snapshot();
+    QVERIFY(empty.begin() == empty.end());
+}
+
+void TestValue::testValueCache()
+{
+    ValueCache<QString> cache;
+    const Value graph(makeBuildGraph(4));
+    QVERIFY(!cache.find(graph));
+    QVERIFY(cache.insert(graph, QString("four")));
+    QCOMPARE(*cache.find(graph), QString("four"));
+
+    // an equal tree sharing nothing with the key is compared deeply
+    const Value copy(makeBuildGraph(4));
+    QVERIFY(!copy.isSharedWith(graph));
+    QCOMPARE(*cache.find(copy), QString("four"));
+    QCOMPARE(*cache.find(copy, ValueCache<QString>::hash(copy)), QString("four"));
+    QVERIFY(!cache.find(Value(makeBuildGraph(5))));
+    QVERIFY(cache.contains(graph));
+
+    QVERIFY(cache.insert(copy, QString("replaced")));
+    QCOMPARE(cache.size(), size_t(1));
+    QCOMPARE(*cache.find(graph), QString("replaced"));
+
+    int computed = 0;
+    const auto compute = [&computed](const Value &key) {
+        ++computed;
+        return QString::number(qint64(key.get<Array>().size()));
+    };
+    const Value five(makeBuildGraph(5));
+    QCOMPARE(cache.getOrCompute(five, compute), QString("5"));
+    QCOMPARE(cache.getOrCompute(five, compute), QString("5"));
+    QCOMPARE(computed, 1);
+
+    auto statistics = cache.statistics();
+    QCOMPARE(statistics.hits, size_t(5));
+    QCOMPARE(statistics.misses, size_t(3));
+    QCOMPARE(statistics.hitRate(), 5. / 8.);
+    QCOMPARE(statistics.entries, size_t(2));
+    QCOMPARE(statistics.bytes, cache.bytes());
+    QVERIFY(cache.bytes() > estimatedSize(graph) + estimatedSize(five));
+    QVERIFY(estimatedSize(five) > estimatedSize(graph));
+
+    QVERIFY(cache.remove(five));
+    QVERIFY(!cache.remove(five));
+    QCOMPARE(cache.size(), size_t(1));
+    cache.clear();
+    QCOMPARE(cache.bytes(), size_t(0));
+    cache.resetStatistics();
+    QCOMPARE(cache.statistics().hits, size_t(0));
+
+    // entries referenced since the hand last passed survive the eviction
+    QVERIFY(cache.insert(0, QString()));
+    const auto entrySize = cache.bytes();
+    cache.setBudget(4 * entrySize);
+    for (int key = 1; key < 4; ++key)
+        QVERIFY(cache.insert(key, QString()));
+    QCOMPARE(cache.statistics().evictions, size_t(0));
+    QVERIFY(cache.find(0));
+    QVERIFY(cache.insert(4, QString()));
+    QCOMPARE(cache.statistics().evictions, size_t(1));
+    QVERIFY(cache.contains(0));
+    QVERIFY(!cache.contains(1));
+    QVERIFY(cache.contains(4));
+    QVERIFY(cache.bytes() <= cache.budget());
+    cache.setBudget(2 * entrySize);
+    QCOMPARE(cache.size(), size_t(2));
+
+    // an entry larger than the budget is not cached
+    QVERIFY(!cache.insert(graph, QString()));
+    QVERIFY(!cache.contains(graph));
+    // and does not replace the cached value of its key
+    QVERIFY(cache.contains(4));
+    QVERIFY(!cache.insert(4, QString(), cache.budget()));
+    QVERIFY(cache.find(4));
+}
+
+void TestValue::testCopyTracker()
+{
+    const Array graph = makeBuildGraph(8);
+    Array copy = graph;
+
+    // copies share the data, reading them does not detach it
+    QVERIFY_NO_DEEP_COPIES({
+        const Value value(copy);
+        const auto record = value.get<Array>().at(0).value<Object>();
+        const auto options = record.value<Object>("options");
+        QCOMPARE(options.value<Array>("defines").size(), size_t(2));
+        Array moved = std::move(copy);
+        copy = moved;
+        // containers owning their data are modified in place
+        Array fresh;
+        fresh.append(record);
+        fresh[0] = value;
+    });
+    QVERIFY(copy.isSharedWith(graph));
+
+    const CopyCounter counter;
+    const int appendLine = __LINE__ + 1;
+    copy.append(Value());
+    auto record = copy.at(1).value<Object>();
+    record.erase("path");
+    const auto variant = Value(makeConfig<QString>(4)).toQVariant();
+    const int conversionLine = __LINE__ + 1;
+    const auto converted = Value::fromQVariant(variant);
+    QCOMPARE(converted.get<Array>().size(), size_t(4));
+
+#if !defined(RECURSIVEVARIANT_TRACK_COPIES)
+    // default builds keep the plain signatures
+    static_assert(std::is_same_v<decltype(&Array::append), void (Array::*)(Value)>);
+    static_assert(std::is_same_v<decltype(&Value::toQVariant), QVariant (Value::*)() const>);
+#endif
+    if (!CopyTracker::isEnabled()) {
+        QCOMPARE(counter.deepCopies(), size_t(0));
+        QCOMPARE(counter.conversions(), size_t(0));
+        QVERIFY(CopyTracker::sites().empty());
+        QVERIFY(CopyTracker::report().isEmpty());
+        return;
+    }
+
+    // the array and the record were shared, the nested values of the conversions are not
+    // counted separately
+    QCOMPARE(counter.deepCopies(), size_t(2));
+    QCOMPARE(counter.copiedElements(), size_t(8 + 3));
+    QCOMPARE(counter.conversions(), size_t(2));
+    QCOMPARE(counter.lastSite().line(), conversionLine);
+    QVERIFY(counter.toString().startsWith("2 deep copies of 11 elements"));
+
+    const auto sites = CopyTracker::sites();
+    const CopyTracker::Site *append = nullptr;
+    for (const auto &site: sites) {
+        if (site.line == appendLine)
+            append = &site;
+    }
+    QVERIFY(append);
+    QVERIFY(std::string_view(append->file).find("test_variant.cpp") != std::string_view::npos);
+    QCOMPARE(append->arrayCopies, size_t(1));
+    QCOMPARE(append->copiedElements, size_t(8));
+    // sorted by copied elements
+    QVERIFY(sites.front().copiedElements >= append->copiedElements);
+    QVERIFY(!CopyTracker::report().isEmpty());
+
+    // operator[] cannot report its caller, data() can
+    auto shared = copy;
+    const int dataLine = __LINE__ + 1;
+    shared.data()[0] = Value();
+    QCOMPARE(counter.lastSite().line(), dataLine);
+
+    CopyTracker::reset();
+    QVERIFY(CopyTracker::sites().empty());
+}
+
 void TestValue::benchObject()
 {
     Value value{
@@ -258,5 +2049,518 @@ void TestValue::benchQVariantHash()
     }
 }
 
+void TestValue::benchArraySum()
+{
+    Array array;
+    for (int i = 0; i < 1000000; ++i)
+        array.append(double(i));
+    double sum = 0;
+    QBENCHMARK {
+        sum = 0;
+        for (const auto &item: array)
+            sum += item.get<double>();
+    }
+    QCOMPARE(sum, 499999500000.);
+}
+
+void TestValue::benchDoubleArraySum()
+{
+    DoubleArray array;
+    for (int i = 0; i < 1000000; ++i)
+        array.append(double(i));
+    double sum = 0;
+    QBENCHMARK {
+        sum = array.sum();
+    }
+    QCOMPARE(sum, 499999500000.);
+}
+
+void TestValue::benchHashRange()
+{
+    std::vector<int64_t> data(100000);
+    std::iota(data.begin(), data.end(), 0);
+    size_t result = 0;
+    QBENCHMARK {
+        result += hashRange(data);
+    }
+    QVERIFY(result != 0);
+}
+
+void TestValue::benchHashValue()
+{
+    Object object;
+    for (int i = 0; i < 1000; ++i) {
+        Array array;
+        array.append(i);
+        array.append(QString::number(i));
+        object.insert({QString::number(i), array});
+    }
+    const Value value(object);
+    size_t result = 0;
+    QBENCHMARK {
+        result += std::hash<Value>()(value);
+    }
+    QVERIFY(result != 0);
+}
+
+void TestValue::benchShapedObject()
+{
+    ShapedObject object{{"path", QString("main.cpp")}, {"size", 1}, {"key", 42}};
+    QBENCHMARK {
+        QCOMPARE(object.at("key").get<int>(), 42);
+    }
+}
+
+void TestValue::benchShapedObjectCached()
+{
+    ShapedObject object{{"path", QString("main.cpp")}, {"size", 1}, {"key", 42}};
+    const QString key("key");
+    ShapeCache cache;
+    QBENCHMARK {
+        QCOMPARE(object.at(key, cache).get<int>(), 42);
+    }
+}
+
+void TestValue::benchObjectCached()
+{
+    const Object object = ShapedObject{{"path", QString("main.cpp")}, {"size", 1}, {"key", 42}}
+            .toObject();
+    const Object::Key key("key");
+    LookupHint hint;
+    QBENCHMARK {
+        QCOMPARE(object.at(key, hint).get<int>(), 42);
+    }
+}
+
+void TestValue::benchStringConfig()
+{
+    QBENCHMARK {
+        const auto config = makeConfig<QString>(1000);
+        QCOMPARE(config.at(1).get<Object>().at("compiler").value<QString>(), QString("gcc"));
+    }
+}
+
+void TestValue::benchCompactStringConfig()
+{
+    QBENCHMARK {
+        const auto config = makeConfig<CompactString>(1000);
+        QCOMPARE(config.at(1).get<Object>().at("compiler").get<CompactString>(),
+                 CompactString("gcc"));
+    }
+}
+
+void TestValue::benchObjectIteration()
+{
+    Object object;
+    for (int i = 0; i < 100000; ++i)
+        object.insert({QString::number(i), i});
+    int64_t sum = 0;
+    QBENCHMARK {
+        sum = 0;
+        for (const auto &item: object)
+            sum += item.second.get<int>();
+    }
+    QCOMPARE(sum, int64_t(4999950000));
+}
+
+void TestValue::benchValuePool()
+{
+    const Value graph(makeBuildGraph(1000));
+    QBENCHMARK {
+        ValuePool pool;
+        QCOMPARE(pool.intern(graph).get<Array>().size(), size_t(1000));
+    }
+}
+
+void TestValue::benchEquality()
+{
+    const Value lhs(makeBuildGraph(1000));
+    const Value rhs(makeBuildGraph(1000));
+    QBENCHMARK {
+        QVERIFY(lhs == rhs);
+    }
+}
+
+void TestValue::benchPooledEquality()
+{
+    // distinct top-level arrays, but all records share canonical subtrees
+    ValuePool pool;
+    const auto lhs = pool.intern(Value(makeBuildGraph(1000)));
+    auto rhs = lhs;
+    rhs.get<Array>().append(Value());
+    rhs.get<Array>().data().pop_back();
+    QVERIFY(!lhs.isSharedWith(rhs));
+    QBENCHMARK {
+        QVERIFY(lhs == rhs);
+    }
+}
+
+void TestValue::benchJsonParse()
+{
+    // the build graph as JSON text, fed in 4 KiB chunks as if read from a socket
+    QByteArray json("[");
+    for (int file = 0; file < 10000; ++file) {
+        const int variant = file % 4;
+        if (file)
+            json.append(",\n");
+        const auto variantText = QByteArray::number(variant);
+        json.append("{\"path\": \"src/file");
+        json.append(QByteArray::number(file));
+        json.append(".cpp\", \"flags\": [\"-Wall\", \"-Wextra\", \"-O");
+        json.append(variantText);
+        json.append("\"], \"options\": {\"compiler\": \"gcc\", \"standard\": \"c++17\", \"optimize\": ");
+        json.append(variant ? "true" : "false");
+        json.append(", \"defines\": [\"MODULE_");
+        json.append(variantText);
+        json.append("\", \"NDEBUG\"]}}");
+    }
+    json.append(']');
+    PushParser parser;
+    QBENCHMARK {
+        parser.reset();
+        for (qsizetype pos = 0; pos < json.size(); pos += 4096)
+            parser.feed(QByteArrayView(json.constData() + pos, std::min<qsizetype>(4096, json.size() - pos)));
+        QCOMPARE(parser.finish(), PushParser::Status::Complete);
+        QCOMPARE(parser.takeValue().get<Array>().size(), size_t(10000));
+    }
+}
+
+void TestValue::benchBinaryParse()
+{
+    const auto binary = toBinary(Value(makeBuildGraph(10000)));
+    PushParser parser(PushParser::Format::Binary);
+    QBENCHMARK {
+        parser.reset();
+        for (qsizetype pos = 0; pos < binary.size(); pos += 4096)
+            parser.feed(QByteArrayView(binary.constData() + pos, std::min<qsizetype>(4096, binary.size() - pos)));
+        QCOMPARE(parser.finish(), PushParser::Status::Complete);
+        QCOMPARE(parser.takeValue().get<Array>().size(), size_t(10000));
+    }
+}
+
+// Cost of the dynamic initializer of a static default configuration, paid at startup
+void TestValue::benchDynamicDefaults()
+{
+    QBENCHMARK {
+        const Value defaults(makeDynamicDefaults());
+        QCOMPARE(defaults.get<Object>().size(), size_t(7));
+    }
+}
+
+// The constexpr equivalent has no initializer, reading it is all that runs
+void TestValue::benchConstDefaults()
+{
+    QBENCHMARK {
+        const ValueView defaults(ConstDefaults::defaults);
+        QCOMPARE(defaults.size(), size_t(7));
+        QVERIFY(defaults[u"options"][u"compiler"].toStringView() == u"gcc");
+    }
+}
+
+// Promotion of the constexpr defaults when a Value is needed
+void TestValue::benchConstDefaultsToValue()
+{
+    QBENCHMARK {
+        const Value defaults = ValueView(ConstDefaults::defaults).toValue();
+        QCOMPARE(defaults.get<Object>().size(), size_t(7));
+    }
+}
+
+static Array makeTable(int records)
+{
+    Array result;
+    result.reserve(size_t(records));
+    for (int i = 0; i < records; ++i) {
+        Object record;
+        record.insert({"id", i});
+        record.insert({"name", QString("record%1").arg(i)});
+        result.append(record);
+    }
+    return result;
+}
+
+void TestValue::benchArrayScan()
+{
+    const auto table = makeTable(10000);
+    QBENCHMARK {
+        size_t found = 0;
+        for (int id = 0; id < 10000; id += 100) {
+            for (const auto &record: table) {
+                if (record.get<Object>().value("id") == Value(id)) {
+                    ++found;
+                    break;
+                }
+            }
+        }
+        QCOMPARE(found, size_t(100));
+    }
+}
+
+void TestValue::benchArrayIndexFind()
+{
+    ArrayIndex index(ArrayIndex::Kind::Hash, ValuePath({"id"}));
+    index.rebuild(makeTable(10000));
+    QBENCHMARK {
+        size_t found = 0;
+        for (int id = 0; id < 10000; id += 100)
+            found += index.findFirst(id) != nullptr;
+        QCOMPARE(found, size_t(100));
+    }
+}
+
+void TestValue::benchArrayIndexRebuild_data()
+{
+    QTest::addColumn<int>("threads");
+    for (int threads: {1, 4})
+        QTest::newRow(QByteArray::number(threads).constData()) << threads;
+}
+
+void TestValue::benchArrayIndexRebuild()
+{
+    QFETCH(int, threads);
+    const auto table = makeTable(200000);
+    ArrayIndex index(ArrayIndex::Kind::Sorted, ValuePath({"name"}));
+    QBENCHMARK {
+        index.rebuild(table, unsigned(threads));
+    }
+    QCOMPARE(index.size(), size_t(200000));
+}
+
+void TestValue::benchConcurrentObject_data()
+{
+    QTest::addColumn<bool>("sharded");
+    QTest::addColumn<int>("threads");
+    for (bool sharded: {false, true}) {
+        for (int threads: {1, 2, 4, 8, 16, 32}) {
+            const auto name = QByteArray(sharded ? "sharded/" : "mutex/") + QByteArray::number(threads);
+            QTest::newRow(name.constData()) << sharded << threads;
+        }
+    }
+}
+
+// A cache shared by worker threads, 90% reads and 10% writes, behind a global mutex or sharded
+void TestValue::benchConcurrentObject()
+{
+    QFETCH(bool, sharded);
+    QFETCH(int, threads);
+    const int operations = 400000;
+    std::vector<QString> keys;
+    for (int i = 0; i < 1024; ++i)
+        keys.push_back(QString("key%1").arg(i));
+
+    std::mutex mutex;
+    Object locked;
+    ConcurrentObject concurrent;
+    for (const auto &key: keys) {
+        locked.insert({key, 0});
+        concurrent.insert({key, 0});
+    }
+    const auto work = [&](int thread) {
+        for (int i = thread; i < operations; i += threads) {
+            const auto &key = keys[size_t(i) * 7919 % keys.size()];
+            const bool write = i % 10 == 0;
+            if (sharded) {
+                if (write)
+                    concurrent.insert_or_assign(key, i);
+                else
+                    concurrent.value(key);
+            } else {
+                std::lock_guard lock(mutex);
+                if (write)
+                    locked[key] = i;
+                else
+                    locked.value(key);
+            }
+        }
+    };
+    QBENCHMARK {
+        std::vector<std::thread> workers;
+        for (int thread = 1; thread < threads; ++thread)
+            workers.emplace_back(work, thread);
+        work(0);
+        for (auto &worker: workers)
+            worker.join();
+    }
+}
+
+// Memoized results for config subtrees, probed with equal trees that do not share data
+void TestValue::benchUnorderedMapMemo()
+{
+    const auto keys = makeBuildGraph(1000);
+    const auto probes = makeBuildGraph(1000);
+    std::unordered_map<Value, QString> cache;
+    for (const auto &key: keys)
+        cache.insert({key, QString("result")});
+    QBENCHMARK {
+        size_t hits = 0;
+        for (const auto &probe: probes)
+            hits += cache.count(probe);
+        QCOMPARE(hits, size_t(1000));
+    }
+}
+
+void TestValue::benchValueCacheMemo_data()
+{
+    QTest::addColumn<bool>("cachedHashes");
+    // hashing in the loop is what benchUnorderedMapMemo measures
+    QTest::newRow("hashing") << false;
+    QTest::newRow("cachedHashes") << true;
+}
+
+void TestValue::benchValueCacheMemo()
+{
+    QFETCH(bool, cachedHashes);
+    const auto keys = makeBuildGraph(1000);
+    const auto probes = makeBuildGraph(1000);
+    ValueCache<QString> cache;
+    for (const auto &key: keys)
+        cache.insert(key, QString("result"));
+    // callers that keep the hashes of their keys
+    std::vector<size_t> hashes;
+    for (const auto &probe: probes)
+        hashes.push_back(ValueCache<QString>::hash(probe));
+    QBENCHMARK {
+        size_t hits = 0;
+        for (size_t i = 0; i < probes.size(); ++i) {
+            const auto &probe = probes.at(i);
+            hits += (cachedHashes ? cache.find(probe, hashes[i]) : cache.find(probe)) != nullptr;
+        }
+        QCOMPARE(hits, size_t(1000));
+    }
+}
+
+// Prints percentiles of the time spent by the calling thread dropping a large tree
+template<typename Release>
+static void measureReleaseLatency(const char *name, Release release)
+{
+    const int iterations = 50;
+    std::vector<qint64> latencies;
+    latencies.reserve(iterations);
+    for (int i = 0; i < iterations; ++i) {
+        Value value(makeBuildGraph(20000));
+        QElapsedTimer timer;
+        timer.start();
+        release(std::move(value));
+        latencies.push_back(timer.nsecsElapsed());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    qDebug() << name << "p50:" << latencies[iterations / 2] / 1000 << "us, p99:"
+             << latencies[iterations * 99 / 100] / 1000 << "us, max:"
+             << latencies.back() / 1000 << "us";
+}
+
+void TestValue::benchDestroyLatency()
+{
+    measureReleaseLatency("destructor", [](Value value) { value = Value(); });
+}
+
+void TestValue::benchReleaseAsyncLatency()
+{
+    Reclaimer reclaimer;
+    measureReleaseLatency("Reclaimer", [&reclaimer](Value value) {
+        reclaimer.release(std::move(value));
+    });
+    reclaimer.flush();
+}
+
+void TestValue::benchBinding()
+{
+    FileRecord record;
+    record.path = "src/main.cpp";
+    record.size = 1024;
+    record.flags.defines = QStringList{"NDEBUG"};
+    record.lines = {1, 2, 3};
+    FileRecord copy;
+    QBENCHMARK {
+        const auto status = fromValue(toValue(record), copy);
+        QVERIFY(status.ok());
+    }
+    QCOMPARE(copy.path, record.path);
+}
+
+void TestValue::benchManualBinding()
+{
+    FileRecord record;
+    record.path = "src/main.cpp";
+    record.size = 1024;
+    record.flags.defines = QStringList{"NDEBUG"};
+    record.lines = {1, 2, 3};
+    FileRecord copy;
+    QBENCHMARK {
+        Object flags;
+        flags.insert({"defines", record.flags.defines});
+        Array lines;
+        for (const auto line: record.lines)
+            lines.append(line);
+        Object object;
+        object.insert({"path", record.path});
+        object.insert({"size", record.size});
+        object.insert({"weight", record.weight});
+        object.insert({"language", int64_t(record.language)});
+        object.insert({"flags", flags});
+        object.insert({"lines", lines});
+
+        copy.path = object.value<QString>("path");
+        copy.size = object.value("size").value<int64_t>();
+        copy.weight = object.value("weight").value<double>();
+        copy.language = Language(object.value("language").value<int64_t>());
+        copy.flags.defines = object.value("flags").value<Object>()
+                .value("defines").value<QStringList>();
+        copy.lines.clear();
+        for (const auto &line: object.value("lines").value<Array>())
+            copy.lines.push_back(line.value<int>());
+    }
+    QCOMPARE(copy.path, record.path);
+}
+
+void TestValue::benchKeyHash_data()
+{
+    addKeyLengths();
+}
+
+void TestValue::benchKeyHash()
+{
+    QFETCH(int, length);
+    const auto key = makeKey(length);
+    size_t result = 0;
+    QBENCHMARK {
+        result += StringKernels::hash(key);
+    }
+    QVERIFY(result != 0);
+}
+
+void TestValue::benchQtKeyHash_data()
+{
+    addKeyLengths();
+}
+
+void TestValue::benchQtKeyHash()
+{
+    QFETCH(int, length);
+    const auto key = makeKey(length);
+    size_t result = 0;
+    QBENCHMARK {
+        result += qHash(key);
+    }
+    QVERIFY(result != 0);
+}
+
+void TestValue::benchKeyEqual_data()
+{
+    addKeyLengths();
+}
+
+void TestValue::benchKeyEqual()
+{
+    QFETCH(int, length);
+    const auto key = makeKey(length);
+    const auto other = makeKey(length);
+    bool result = true;
+    QBENCHMARK {
+        result &= StringKernels::equal(key, other);
+    }
+    QVERIFY(result);
+}
+
 QTEST_MAIN(TestValue)
 #include "test_variant.moc"
\ No newline at end of file
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "utils.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+class Array;
+
+// Packed array of native numbers, stored contiguously without per-element Value overhead.
+// A Value holding a TypedArray never equals one holding an Array, even with the same numbers,
+// as int 1 does not equal double 1.0: the representation is part of the value. Convert with
+// fromArray() or toArray() to compare them.
+template<typename T>
+class TypedArray
+{
+    static_assert(std::is_arithmetic_v<T>, "TypedArray supports only arithmetic types");
+public:
+    using Data = std::vector<T>;
+    using iterator = typename Data::iterator;
+    using const_iterator = typename Data::const_iterator;
+    using value_type = T;
+
+    TypedArray() = default;
+    TypedArray(Data data) : d(std::move(data)) {}
+    TypedArray(std::initializer_list<T> list) : d(list) {}
+    template<typename It>
+    TypedArray(It first, It last) : d(first, last) {}
+
+    // Throws std::runtime_error if array holds a non-numeric item, and std::range_error, a
+    // subclass, if it holds a number T does not represent exactly
+    static TypedArray fromArray(const Array &array);
+    Array toArray() const;
+
+    Data &data() noexcept { return d; }
+    const Data &data() const noexcept { return d; }
+
+    iterator begin() noexcept { return d.begin(); }
+    const_iterator begin() const noexcept { return d.cbegin(); }
+    const_iterator cbegin() const noexcept { return d.cbegin(); }
+    const_iterator constBegin() const noexcept { return d.cbegin(); }
+
+    iterator end() noexcept { return d.end(); }
+    const_iterator end() const noexcept { return d.cend(); }
+    const_iterator cend() const noexcept { return d.cend(); }
+    const_iterator constEnd() const noexcept { return d.cend(); }
+
+    const T &at(size_t index) const { return d.at(index); }
+
+    bool empty() const noexcept { return d.empty(); }
+    bool isEmpty() const noexcept { return empty(); }
+    size_t size() const noexcept { return d.size(); }
+    void reserve(size_t size) { d.reserve(size); }
+
+    void append(T v) { d.push_back(v); }
+    void push_back(T v) { d.push_back(v); }
+
+    iterator insert(const_iterator it, T v) { return d.insert(it, v); }
+    template<typename It>
+    iterator insert(const_iterator it, It first, It last) { return d.insert(it, first, last); }
+
+    T &operator[](size_t index) noexcept { return d[index]; }
+    const T &operator[](size_t index) const noexcept { return d[index]; }
+
+    // Reductions; the result for an empty array is T()
+    T sum() const noexcept;
+    T min() const noexcept;
+    T max() const noexcept;
+
+    size_t count(T value) const noexcept;
+    bool contains(T value) const noexcept { return indexOf(value) != size(); }
+    // returns size() if value is not found
+    size_t indexOf(T value, size_t from = 0) const noexcept;
+
+    bool equals(const TypedArray &other) const noexcept;
+
+private:
+    Data d;
+};
+
+using DoubleArray = TypedArray<double>;
+using Int64Array = TypedArray<int64_t>;
+
+// Loops below are written with independent lanes and without early exits in the inner
+// block, so that the compiler can vectorize them without relaxed floating-point math.
+// Note that the lane-wise sum of doubles may differ from the sequential one in the last bits.
+namespace TypedArrayKernels {
+
+constexpr size_t Lanes = 8;
+
+template<typename T>
+T sum(const T *data, size_t size) noexcept
+{
+    T acc[Lanes] = {};
+    size_t i = 0;
+    for (; i + Lanes <= size; i += Lanes) {
+        for (size_t j = 0; j < Lanes; ++j)
+            acc[j] += data[i + j];
+    }
+    for (; i < size; ++i)
+        acc[0] += data[i];
+    T result = T();
+    for (size_t j = 0; j < Lanes; ++j)
+        result += acc[j];
+    return result;
+}
+
+template<typename T, typename Compare>
+T reduce(const T *data, size_t size, Compare compare) noexcept
+{
+    if (size == 0)
+        return T();
+    if (size < Lanes)
+        return *std::min_element(data, data + size, compare);
+
+    T acc[Lanes];
+    std::copy(data, data + Lanes, acc);
+    size_t i = Lanes;
+    for (; i + Lanes <= size; i += Lanes) {
+        for (size_t j = 0; j < Lanes; ++j)
+            acc[j] = compare(data[i + j], acc[j]) ? data[i + j] : acc[j];
+    }
+    for (; i < size; ++i)
+        acc[0] = compare(data[i], acc[0]) ? data[i] : acc[0];
+    return *std::min_element(acc, acc + Lanes, compare);
+}
+
+template<typename T>
+size_t count(const T *data, size_t size, T value) noexcept
+{
+    size_t result = 0;
+    for (size_t i = 0; i < size; ++i)
+        result += data[i] == value ? 1 : 0;
+    return result;
+}
+
+template<typename T>
+size_t indexOf(const T *data, size_t size, size_t from, T value) noexcept
+{
+    size_t i = from;
+    for (; i + Lanes <= size; i += Lanes) {
+        bool found = false;
+        for (size_t j = 0; j < Lanes; ++j)
+            found |= data[i + j] == value;
+        if (found)
+            break;
+    }
+    for (; i < size; ++i) {
+        if (data[i] == value)
+            return i;
+    }
+    return size;
+}
+
+template<typename T>
+bool equal(const T *lhs, const T *rhs, size_t size) noexcept
+{
+    size_t i = 0;
+    for (; i + Lanes <= size; i += Lanes) {
+        bool same = true;
+        for (size_t j = 0; j < Lanes; ++j)
+            same &= lhs[i + j] == rhs[i + j];
+        if (!same)
+            return false;
+    }
+    for (; i < size; ++i) {
+        if (!(lhs[i] == rhs[i]))
+            return false;
+    }
+    return true;
+}
+
+} // namespace TypedArrayKernels
+
+template<typename T>
+inline T TypedArray<T>::sum() const noexcept
+{
+    return TypedArrayKernels::sum(d.data(), d.size());
+}
+
+template<typename T>
+inline T TypedArray<T>::min() const noexcept
+{
+    return TypedArrayKernels::reduce(d.data(), d.size(), std::less<T>());
+}
+
+template<typename T>
+inline T TypedArray<T>::max() const noexcept
+{
+    return TypedArrayKernels::reduce(d.data(), d.size(), std::greater<T>());
+}
+
+template<typename T>
+inline size_t TypedArray<T>::count(T value) const noexcept
+{
+    return TypedArrayKernels::count(d.data(), d.size(), value);
+}
+
+template<typename T>
+inline size_t TypedArray<T>::indexOf(T value, size_t from) const noexcept
+{
+    return TypedArrayKernels::indexOf(d.data(), d.size(), std::min(from, d.size()), value);
+}
+
+template<typename T>
+inline bool TypedArray<T>::equals(const TypedArray &other) const noexcept
+{
+    return d.size() == other.d.size()
+            && TypedArrayKernels::equal(d.data(), other.d.data(), d.size());
+}
+
+template<typename T>
+inline bool operator==(const TypedArray<T> &lhs, const TypedArray<T> &rhs)
+{
+    return lhs.equals(rhs);
+}
+
+template<typename T>
+inline bool operator!=(const TypedArray<T> &lhs, const TypedArray<T> &rhs)
+{
+    return !lhs.equals(rhs);
+}
+
+namespace std {
+
+template<typename T> struct hash<TypedArray<T>>
+{
+    std::size_t operator()(const TypedArray<T> &s) const noexcept
+    {
+        return hashRange(s.data());
+    }
+};
+
+} // namespace std
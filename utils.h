@@ -1,33 +1,242 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include "compactstring.h"
+#include "stringkernels.h"
+
+#include <QtCore/QByteArray>
 #include <QStringList>
 
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <random>
+#include <type_traits>
 #include <unordered_map>
 
-// based on http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2017/p0814r0.pdf
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+// 64 bit hashing primitives based on the wyhash multiply-fold mixer.
+// The secrets are derived from a per-process seed which is random by default, like the seed
+// of QHash, so that inputs cannot be crafted to collide. Set the RECURSIVEVARIANT_HASH_SEED
+// environment variable to a number to use a fixed seed and get the same hashes in every run,
+// when debugging for instance.
+namespace Hashing {
+
+struct Secrets
+{
+    uint64_t seed;
+    uint64_t k0;
+    uint64_t k1;
+    uint64_t k2;
+};
+
+inline uint64_t mix(uint64_t a, uint64_t b) noexcept
+{
+#if defined(__SIZEOF_INT128__)
+    const __uint128_t r = __uint128_t(a) * b;
+    return uint64_t(r) ^ uint64_t(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t hi;
+    const uint64_t lo = _umul128(a, b, &hi);
+    return lo ^ hi;
+#else
+    const uint64_t ha = a >> 32, hb = b >> 32, la = uint32_t(a), lb = uint32_t(b);
+    const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    const uint64_t t = rl + (rm0 << 32);
+    const uint64_t lo = t + (rm1 << 32);
+    const uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t);
+    return lo ^ hi;
+#endif
+}
+
+inline Secrets makeSecrets(uint64_t seed) noexcept
+{
+    // splitmix64 expansion of the seed
+    auto next = [&seed] {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return (z ^ (z >> 31)) | 1;
+    };
+    const uint64_t initial = seed;
+    const uint64_t k0 = next();
+    const uint64_t k1 = next();
+    const uint64_t k2 = next();
+    return {initial, k0, k1, k2};
+}
+
+inline uint64_t seedFromEnvironment()
+{
+    const QByteArray value = qgetenv("RECURSIVEVARIANT_HASH_SEED");
+    // "random" was the opt-in before random seeds became the default
+    if (value.isEmpty() || value == QByteArray("random")) {
+        std::random_device device;
+        return (uint64_t(device()) << 32) ^ device();
+    }
+    return std::strtoull(value.constData(), nullptr, 0);
+}
+
+inline const Secrets &secrets() noexcept
+{
+    static const Secrets result = makeSecrets(seedFromEnvironment());
+    return result;
+}
+
+inline size_t seed() noexcept { return size_t(secrets().seed ^ secrets().k2); }
+
+// Mixes value into the running state; not commutative. The product alone is 0 whenever one
+// operand hits its secret, whatever the other one is, so both inputs are folded back into
+// the result.
+inline size_t combine(size_t state, size_t value) noexcept
+{
+    const auto &s = secrets();
+    return size_t(mix(uint64_t(state) ^ s.k0, uint64_t(value) ^ s.k1) ^ uint64_t(state)
+                  ^ (uint64_t(value) << 32 | uint64_t(value) >> 32));
+}
+
+inline size_t finalize(size_t state, size_t count) noexcept
+{
+    const auto &s = secrets();
+    return size_t(mix(uint64_t(state) ^ s.k2, uint64_t(count) ^ s.k0));
+}
+
+} // namespace Hashing
+
+// QString, QStringView and CompactString with the same text have the same hash and compare
+// equal. Transparent, so maps keyed by CompactString can be searched with a QString or a
+// QStringView without converting it.
+struct StringKeyHash
+{
+    using is_transparent = void;
+
+    size_t operator()(const QString &s) const noexcept
+    {
+        return StringKernels::hash(s, Hashing::seed());
+    }
+
+    size_t operator()(QStringView s) const noexcept
+    {
+        return StringKernels::hash(s, Hashing::seed());
+    }
+
+    size_t operator()(const CompactString &s) const noexcept
+    {
+        return s.hash(Hashing::seed());
+    }
+};
+
+struct StringKeyEqual
+{
+    using is_transparent = void;
+
+    bool operator()(const QString &lhs, const QString &rhs) const noexcept
+    {
+        return StringKernels::equal(lhs, rhs);
+    }
+
+    bool operator()(const QString &lhs, QStringView rhs) const noexcept
+    {
+        return size_t(lhs.size()) == size_t(rhs.size())
+                && StringKernels::equalUtf16(StringKernels::utf16(lhs),
+                                             reinterpret_cast<const char16_t *>(rhs.utf16()),
+                                             size_t(rhs.size()));
+    }
+
+    bool operator()(const CompactString &lhs, const CompactString &rhs) const noexcept
+    {
+        return lhs.equals(rhs);
+    }
+
+    bool operator()(const CompactString &lhs, const QString &rhs) const noexcept
+    {
+        return lhs.equals(rhs);
+    }
+
+    bool operator()(const CompactString &lhs, QStringView rhs) const noexcept
+    {
+        return lhs.equals(rhs);
+    }
+};
+
+// Converts value to To if To represents it exactly: no rounding, truncation, wrapping or
+// overflow. NaN only converts between floating-point types.
+template<typename To, typename From>
+std::optional<To> exactCast(From value) noexcept
+{
+    static_assert(std::is_arithmetic_v<To> && std::is_arithmetic_v<From>,
+                  "exactCast converts between arithmetic types");
+    if constexpr (std::is_floating_point_v<From> && std::is_floating_point_v<To>) {
+        if (std::isnan(value))
+            return To(value);
+        if (std::isfinite(value) && std::abs(value) > std::numeric_limits<To>::max())
+            return std::nullopt;
+        const To result = To(value);
+        if (From(result) != value)
+            return std::nullopt;
+        return result;
+    } else if constexpr (std::is_floating_point_v<From>) {
+        // the bounds are powers of two, exact in any floating-point type; NaN fails both
+        const From upper = std::ldexp(From(1), std::numeric_limits<To>::digits);
+        const From lower = std::is_signed_v<To> ? -upper : From(0);
+        if (!(value >= lower && value < upper))
+            return std::nullopt;
+        const To result = To(value);
+        if (From(result) != value)
+            return std::nullopt;
+        return result;
+    } else if constexpr (std::is_floating_point_v<To>) {
+        const To result = To(value);
+        // rounding may reach 2^digits, which does not convert back
+        if (result >= std::ldexp(To(1), std::numeric_limits<From>::digits))
+            return std::nullopt;
+        if (From(result) != value)
+            return std::nullopt;
+        return result;
+    } else {
+        const auto isNegative = [](auto v) {
+            if constexpr (std::is_signed_v<decltype(v)>)
+                return v < 0;
+            else
+                return false;
+        };
+        const To result = To(value);
+        if (From(result) != value || isNegative(result) != isNegative(value))
+            return std::nullopt;
+        return result;
+    }
+}
+
 template<typename T>
 void hashCombineHelper(size_t &seed, const T &val)
 {
-    seed ^= std::hash<T>()(val) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed = Hashing::combine(seed, std::hash<T>()(val));
 }
 
 template<typename... Types>
 size_t hashCombine(const Types &... args)
 {
-    size_t seed = 0;
-    (hashCombineHelper(seed, args), ...); // create hash value with seed over all args return seed;
-    return seed;
+    size_t seed = Hashing::seed();
+    (hashCombineHelper(seed, args), ...);
+    return Hashing::finalize(seed, sizeof...(args));
 }
 
+// Order-dependent hash of a range. Elements are mixed into two interleaved states to
+// shorten the dependency chain of the multiplications.
 template<typename It>
 size_t hashRange(It first, It last)
 {
-    size_t seed = 0;
-    for (; first != last; ++first)
-        hashCombineHelper(seed, *first);
+    size_t even = Hashing::seed();
+    size_t odd = ~even;
+    size_t count = 0;
+    for (; first != last; ++first, ++count)
+        hashCombineHelper((count & 1) ? odd : even, *first);
 
-    return seed;
+    return Hashing::finalize(Hashing::combine(even, odd), count);
 }
 
 template<typename R>
@@ -36,13 +245,57 @@ size_t hashRange(R &&range)
     return hashRange(std::begin(range), std::end(range));
 }
 
+// Order-independent hash of a range, for containers with unspecified iteration order.
+// hash returns the hash of an element, std::hash by default.
+template<typename It, typename Hash>
+size_t hashUnordered(It first, It last, Hash hash)
+{
+    size_t sum = 0;
+    size_t count = 0;
+    for (; first != last; ++first, ++count)
+        sum += Hashing::combine(Hashing::seed(), hash(*first));
+
+    return Hashing::finalize(sum, count);
+}
+
+template<typename It>
+size_t hashUnordered(It first, It last)
+{
+    using T = std::decay_t<decltype(*first)>;
+    return hashUnordered(first, last, std::hash<T>());
+}
+
+template<typename R, typename Hash>
+size_t hashUnordered(R &&range, Hash hash)
+{
+    return hashUnordered(std::begin(range), std::end(range), std::move(hash));
+}
+
+template<typename R>
+size_t hashUnordered(R &&range)
+{
+    return hashUnordered(std::begin(range), std::end(range));
+}
+
 namespace std {
 
 template<> struct hash<QStringList>
 {
     std::size_t operator()(const QStringList &s) const noexcept
     {
-        return hashRange(s);
+        // chain the strings through the seed instead of combining separate hashes
+        size_t seed = Hashing::seed();
+        for (const auto &item: s)
+            seed = StringKernels::hash(item, seed);
+        return Hashing::finalize(seed, size_t(s.size()));
+    }
+};
+
+template<> struct hash<CompactString>
+{
+    std::size_t operator()(const CompactString &s) const noexcept
+    {
+        return StringKeyHash()(s);
     }
 };
 
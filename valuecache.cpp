@@ -0,0 +1,55 @@
+#include "valuecache.h"
+
+namespace {
+
+size_t stringSize(const QString &s)
+{
+    // the header of the shared block and the UTF-16 data
+    return s.isEmpty() ? 0 : 16 + size_t(s.size()) * sizeof(QChar);
+}
+
+size_t stringSize(const CompactString &s)
+{
+    return s.heapSize();
+}
+
+} // namespace
+
+size_t estimatedSize(const Value &value)
+{
+    size_t result = sizeof(Value);
+    switch (value.type()) {
+    case Value::Type::String:
+        result += stringSize(value.get<QString>());
+        break;
+    case Value::Type::CompactString:
+        result += stringSize(value.get<CompactString>());
+        break;
+    case Value::Type::StringList:
+        for (const auto &item: value.get<QStringList>())
+            result += sizeof(QString) + stringSize(item);
+        break;
+    case Value::Type::Array:
+        result += sizeof(Array::Data);
+        for (const auto &item: value.get<Array>())
+            result += estimatedSize(item);
+        break;
+    case Value::Type::Object:
+        result += sizeof(Object::Data);
+        for (const auto &item: value.get<Object>()) {
+            // the entry and its index slot
+            result += sizeof(ObjectKey) + stringSize(item.first) + sizeof(void *)
+                    + estimatedSize(item.second);
+        }
+        break;
+    case Value::Type::DoubleArray:
+        result += value.get<DoubleArray>().size() * sizeof(double);
+        break;
+    case Value::Type::Int64Array:
+        result += value.get<Int64Array>().size() * sizeof(int64_t);
+        break;
+    default:
+        break;
+    }
+    return result;
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "variant.h"
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Approximate number of bytes used by a value tree, counting shared data as if it was not
+size_t estimatedSize(const Value &value);
+
+// Memoization cache keyed by Value trees, such as config subtrees mapped to results computed
+// from them. Keys are stored with their hash: a probe only compares keys with the same hash,
+// and a key sharing its data with the stored one matches without a deep comparison. Callers
+// keeping the hash of a key can pass it to skip hashing as well.
+//
+// Entries are evicted with the CLOCK algorithm, an approximation of LRU where a hit only sets
+// a flag, when the estimated size of the keys and values exceeds the byte budget. Not
+// thread-safe.
+template<typename V>
+class ValueCache
+{
+public:
+    static constexpr size_t DefaultBudget = 16 * 1024 * 1024;
+
+    struct Statistics
+    {
+        size_t hits{0};
+        size_t misses{0};
+        size_t evictions{0};
+        size_t entries{0};
+        size_t bytes{0};
+        size_t budget{0};
+
+        double hitRate() const noexcept
+        {
+            return hits + misses ? double(hits) / double(hits + misses) : 0.0;
+        }
+    };
+
+    explicit ValueCache(size_t budget = DefaultBudget) : m_budget(budget) {}
+
+    static size_t hash(const Value &key) noexcept { return std::hash<Value>()(key); }
+
+    // The cached value for key, or nullptr. The pointer is valid until the cache is next
+    // modified: insert(), remove(), clear() and setBudget() may all destroy the entry.
+    const V *find(const Value &key) { return find(key, hash(key)); }
+    const V *find(const Value &key, size_t hash);
+    bool contains(const Value &key) const { return lookup(key, hash(key)) != npos; }
+
+    // Caches value for key, replacing any previous value. valueSize is the estimated number of
+    // bytes value uses outside of itself, such as string data. Returns false if the entry alone
+    // exceeds the budget and was not cached, a previous value for key is then kept.
+    bool insert(Value key, V value, size_t valueSize = 0);
+    bool insert(Value key, size_t hash, V value, size_t valueSize = 0);
+
+    // Returns the cached value for key, calling compute(key) and caching its result on a miss
+    template<typename Compute>
+    V getOrCompute(const Value &key, Compute compute, size_t valueSize = 0);
+
+    bool remove(const Value &key);
+    void clear();
+
+    size_t size() const noexcept { return m_index.size(); }
+    bool isEmpty() const noexcept { return size() == 0; }
+    // Estimated size of the cached keys and values
+    size_t bytes() const noexcept { return m_bytes; }
+    size_t budget() const noexcept { return m_budget; }
+    // Evicts entries until the cache fits
+    void setBudget(size_t budget);
+
+    Statistics statistics() const noexcept;
+    void resetStatistics() noexcept;
+
+private:
+    static constexpr size_t npos = size_t(-1);
+
+    struct Slot
+    {
+        Value key;
+        size_t hash{0};
+        V value{};
+        size_t bytes{0};
+        bool used{false};
+        bool referenced{false};
+    };
+
+    // the hash is already well mixed
+    struct Identity
+    {
+        size_t operator()(size_t hash) const noexcept { return hash; }
+    };
+
+    size_t lookup(const Value &key, size_t hash) const;
+    void erase(size_t slot);
+    void makeRoom(size_t bytes);
+
+    std::vector<Slot> m_slots;
+    std::vector<size_t> m_freeSlots;
+    std::unordered_multimap<size_t, size_t, Identity> m_index;
+    size_t m_hand{0};
+    size_t m_bytes{0};
+    size_t m_budget;
+    Statistics m_statistics;
+};
+
+template<typename V>
+const V *ValueCache<V>::find(const Value &key, size_t hash)
+{
+    const auto slot = lookup(key, hash);
+    if (slot == npos) {
+        ++m_statistics.misses;
+        return nullptr;
+    }
+    ++m_statistics.hits;
+    m_slots[slot].referenced = true;
+    return &m_slots[slot].value;
+}
+
+template<typename V>
+bool ValueCache<V>::insert(Value key, V value, size_t valueSize)
+{
+    const auto keyHash = hash(key);
+    return insert(std::move(key), keyHash, std::move(value), valueSize);
+}
+
+template<typename V>
+bool ValueCache<V>::insert(Value key, size_t hash, V value, size_t valueSize)
+{
+    const size_t bytes = sizeof(Slot) + estimatedSize(key) - sizeof(Value) + valueSize;
+    if (bytes > m_budget)
+        return false;
+    const auto existing = lookup(key, hash);
+    if (existing != npos)
+        erase(existing);
+    makeRoom(bytes);
+
+    size_t slot;
+    if (!m_freeSlots.empty()) {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else {
+        slot = m_slots.size();
+        m_slots.emplace_back();
+    }
+    m_slots[slot] = {std::move(key), hash, std::move(value), bytes, true, false};
+    m_index.emplace(hash, slot);
+    m_bytes += bytes;
+    return true;
+}
+
+template<typename V>
+template<typename Compute>
+V ValueCache<V>::getOrCompute(const Value &key, Compute compute, size_t valueSize)
+{
+    const auto keyHash = hash(key);
+    if (const auto cached = find(key, keyHash))
+        return *cached;
+    V value = compute(key);
+    insert(key, keyHash, value, valueSize);
+    return value;
+}
+
+template<typename V>
+bool ValueCache<V>::remove(const Value &key)
+{
+    const auto slot = lookup(key, hash(key));
+    if (slot == npos)
+        return false;
+    erase(slot);
+    return true;
+}
+
+template<typename V>
+void ValueCache<V>::clear()
+{
+    m_slots.clear();
+    m_freeSlots.clear();
+    m_index.clear();
+    m_hand = 0;
+    m_bytes = 0;
+}
+
+template<typename V>
+void ValueCache<V>::setBudget(size_t budget)
+{
+    m_budget = budget;
+    makeRoom(0);
+}
+
+template<typename V>
+auto ValueCache<V>::statistics() const noexcept -> Statistics
+{
+    auto result = m_statistics;
+    result.entries = size();
+    result.bytes = m_bytes;
+    result.budget = m_budget;
+    return result;
+}
+
+template<typename V>
+void ValueCache<V>::resetStatistics() noexcept
+{
+    m_statistics = {};
+}
+
+template<typename V>
+size_t ValueCache<V>::lookup(const Value &key, size_t hash) const
+{
+    const auto [begin, end] = m_index.equal_range(hash);
+    for (auto it = begin; it != end; ++it) {
+        // operator== skips the deep comparison of shared data
+        if (m_slots[it->second].key == key)
+            return it->second;
+    }
+    return npos;
+}
+
+template<typename V>
+void ValueCache<V>::erase(size_t slot)
+{
+    auto &entry = m_slots[slot];
+    const auto [begin, end] = m_index.equal_range(entry.hash);
+    for (auto it = begin; it != end; ++it) {
+        if (it->second == slot) {
+            m_index.erase(it);
+            break;
+        }
+    }
+    m_bytes -= entry.bytes;
+    entry = Slot();
+    m_freeSlots.push_back(slot);
+}
+
+template<typename V>
+void ValueCache<V>::makeRoom(size_t bytes)
+{
+    // the hand clears the referenced flags it passes and evicts the first entry without one
+    while (m_bytes + bytes > m_budget && !m_index.empty()) {
+        if (m_hand >= m_slots.size())
+            m_hand = 0;
+        auto &entry = m_slots[m_hand];
+        if (entry.used && !entry.referenced) {
+            erase(m_hand);
+            ++m_statistics.evictions;
+        } else {
+            entry.referenced = false;
+        }
+        ++m_hand;
+    }
+}
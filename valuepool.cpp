@@ -0,0 +1,224 @@
+#include "valuepool.h"
+
+namespace {
+
+constexpr std::pair<Value::Type, const char *> Kinds[] = {
+    {Value::Type::String, "String"},
+    {Value::Type::StringList, "StringList"},
+    {Value::Type::Array, "Array"},
+    {Value::Type::Object, "Object"},
+    {Value::Type::CompactString, "CompactString"},
+};
+
+QString statisticsLine(const char *name, const ValuePool::Statistics &statistics)
+{
+    return QString::fromLatin1(name) + QString::fromLatin1(": ")
+            + QString::number(qint64(statistics.values)) + QString::fromLatin1(" values, ")
+            + QString::number(qint64(statistics.unique)) + QString::fromLatin1(" unique, ratio ")
+            + QString::number(statistics.ratio(), 'f', 2) + QString::fromLatin1("\n");
+}
+
+// Value's operator== ignores the order of object keys, interning must not, or objects would
+// take the key order of the first equal one interned
+bool sameNode(const Value &lhs, const Value &rhs)
+{
+    if (lhs.isSharedWith(rhs))
+        return true;
+    if (lhs.type() != rhs.type())
+        return false;
+    switch (lhs.type()) {
+    case Value::Type::Array: {
+        const auto &l = lhs.get<Array>();
+        const auto &r = rhs.get<Array>();
+        if (l.size() != r.size())
+            return false;
+        for (size_t i = 0; i < l.size(); ++i) {
+            if (!sameNode(l[i], r[i]))
+                return false;
+        }
+        return true;
+    }
+#if !defined(RECURSIVEVARIANT_UNORDERED_OBJECTS)
+    case Value::Type::Object: {
+        const auto &l = lhs.get<Object>();
+        const auto &r = rhs.get<Object>();
+        if (l.size() != r.size())
+            return false;
+        for (auto li = l.begin(), ri = r.begin(); li != l.end(); ++li, ++ri) {
+            if (!StringKeyEqual()(li->first, ri->first) || !sameNode(li->second, ri->second))
+                return false;
+        }
+        return true;
+    }
+#endif
+    default:
+        return lhs == rhs;
+    }
+}
+
+} // namespace
+
+Value ValuePool::intern(const Value &value)
+{
+    size_t hash = 0;
+    return internNode(value, hash);
+}
+
+QString ValuePool::intern(const QString &value)
+{
+    auto &statistics = m_statistics[size_t(Value::Type::String)];
+    ++statistics.values;
+    const auto result = m_strings.insert(value);
+    if (result.second)
+        ++statistics.unique;
+    return *result.first;
+}
+
+Array ValuePool::intern(const Array &value)
+{
+    return intern(Value(value)).get<Array>();
+}
+
+Object ValuePool::intern(const Object &value)
+{
+    return intern(Value(value)).get<Object>();
+}
+
+CompactString ValuePool::internCompact(const CompactString &value)
+{
+    // inline strings do not allocate, there is nothing to share
+    if (value.isInline())
+        return value;
+    auto &statistics = m_statistics[size_t(Value::Type::CompactString)];
+    ++statistics.values;
+    const auto result = m_compactStrings.insert(value);
+    if (result.second)
+        ++statistics.unique;
+    return *result.first;
+}
+
+ObjectKey ValuePool::internKey(const ObjectKey &key)
+{
+#if defined(RECURSIVEVARIANT_COMPACT_KEYS)
+    return internCompact(key);
+#else
+    return intern(key);
+#endif
+}
+
+Value ValuePool::internNode(const Value &value, size_t &hash)
+{
+    switch (value.type()) {
+    case Value::Type::String: {
+        Value result(intern(value.get<QString>()));
+        hash = std::hash<Value>()(result);
+        return result;
+    }
+    case Value::Type::CompactString: {
+        Value result(internCompact(value.get<CompactString>()));
+        hash = std::hash<Value>()(result);
+        return result;
+    }
+    case Value::Type::StringList: {
+        const auto &list = value.get<QStringList>();
+        QStringList result;
+        result.reserve(list.size());
+        for (const auto &item: list)
+            result.append(intern(item));
+        hash = std::hash<Value>()(result);
+        return canonical(std::move(result), hash);
+    }
+    case Value::Type::Array: {
+        // children are canonical, so their hashes are computed once and equality checks
+        // against existing nodes stop at shared children
+        const auto &array = value.get<Array>();
+        Array result;
+        result.reserve(array.size());
+        size_t state = Hashing::seed();
+        for (const auto &item: array) {
+            size_t itemHash = 0;
+            result.append(internNode(item, itemHash));
+            state = Hashing::combine(state, itemHash);
+        }
+        hash = Hashing::finalize(state, array.size());
+        return canonical(std::move(result), hash);
+    }
+    case Value::Type::Object: {
+        const auto &object = value.get<Object>();
+        Object result;
+        result.reserve(object.size());
+        size_t state = Hashing::seed();
+        for (const auto &item: object) {
+            size_t itemHash = 0;
+            auto itemValue = internNode(item.second, itemHash);
+            const size_t entryHash = Hashing::combine(StringKeyHash()(item.first), itemHash);
+#if defined(RECURSIVEVARIANT_UNORDERED_OBJECTS)
+            // the iteration order is unspecified, entries are combined commutatively
+            state += entryHash;
+#else
+            // the key order is kept, objects differing only by it are distinct nodes
+            state = Hashing::combine(state, entryHash);
+#endif
+            result.insert({internKey(item.first), std::move(itemValue)});
+        }
+        hash = Hashing::finalize(state, object.size());
+        return canonical(std::move(result), hash);
+    }
+    default:
+        hash = std::hash<Value>()(value);
+        return value;
+    }
+}
+
+Value ValuePool::canonical(Value value, size_t hash)
+{
+    auto &statistics = m_statistics[value.index()];
+    ++statistics.values;
+    const auto range = m_nodes.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (sameNode(it->second, value))
+            return it->second;
+    }
+    ++statistics.unique;
+    return m_nodes.emplace(hash, std::move(value))->second;
+}
+
+auto ValuePool::statistics(Value::Type type) const noexcept -> Statistics
+{
+    return m_statistics[size_t(type)];
+}
+
+auto ValuePool::statistics() const noexcept -> Statistics
+{
+    Statistics result;
+    for (const auto &kind: Kinds) {
+        result.values += m_statistics[size_t(kind.first)].values;
+        result.unique += m_statistics[size_t(kind.first)].unique;
+    }
+    return result;
+}
+
+QString ValuePool::report() const
+{
+    QString result;
+    for (const auto &kind: Kinds) {
+        if (m_statistics[size_t(kind.first)].values)
+            result += statisticsLine(kind.second, m_statistics[size_t(kind.first)]);
+    }
+    result += statisticsLine("Total", statistics());
+    return result;
+}
+
+size_t ValuePool::size() const noexcept
+{
+    return m_strings.size() + m_compactStrings.size() + m_nodes.size();
+}
+
+void ValuePool::clear()
+{
+    m_strings.clear();
+    m_compactStrings.clear();
+    m_nodes.clear();
+    for (auto &statistics: m_statistics)
+        statistics = {};
+}
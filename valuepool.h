@@ -0,0 +1,58 @@
+#pragma once
+
+#include "variant.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+// Hash-consing factory for Values. Structurally equal strings, string lists, arrays and
+// objects passed through intern() are replaced by a single canonical instance owned by the
+// pool, so repeated subtrees are stored once. Objects only share an instance with objects
+// having their keys in the same order, so interning keeps the key order of each one. Interning works bottom-up: a canonical container
+// only holds canonical children, so comparing two canonical values is a pointer comparison at
+// the first shared level (see Value::isSharedWith()).
+//
+// Canonical values are ordinary implicitly shared Values; modifying one detaches it from the
+// pool. Typed arrays and scalars are returned as they are. Not thread-safe.
+class ValuePool
+{
+public:
+    struct Statistics
+    {
+        // number of nodes passed through intern(), including nested ones and object keys
+        size_t values{0};
+        // number of canonical nodes created for them
+        size_t unique{0};
+
+        double ratio() const noexcept { return unique ? double(values) / double(unique) : 1.0; }
+    };
+
+    Value intern(const Value &value);
+    QString intern(const QString &value);
+    Array intern(const Array &value);
+    Object intern(const Object &value);
+
+    // Statistics for one kind of node (String, StringList, Array, Object or CompactString)
+    Statistics statistics(Value::Type type) const noexcept;
+    // Statistics for all kinds
+    Statistics statistics() const noexcept;
+    // Human-readable deduplication report, one line per kind and a total
+    QString report() const;
+
+    // Number of canonical nodes held by the pool
+    size_t size() const noexcept;
+    // Releases the canonical nodes, values returned earlier stay valid
+    void clear();
+
+private:
+    Value internNode(const Value &value, size_t &hash);
+    ObjectKey internKey(const ObjectKey &key);
+    CompactString internCompact(const CompactString &value);
+    Value canonical(Value value, size_t hash);
+
+    std::unordered_set<QString, StringKeyHash, StringKeyEqual> m_strings;
+    std::unordered_set<CompactString, StringKeyHash, StringKeyEqual> m_compactStrings;
+    // string lists, arrays and objects by their structural hash
+    std::unordered_multimap<size_t, Value> m_nodes;
+    Statistics m_statistics[size_t(Value::Type::CompactString) + 1];
+};
@@ -5,11 +5,15 @@
 
 //using StdVariant = QbsVariantBase;
 
+// The conversions of the nested values, only the outer call is counted as a conversion
+QVariant toVariant(const Value &v);
+Value fromVariant(const QVariant &v);
+
 Object fromVariantHash(const QVariantHash &map)
 {
     Object result;
     for (auto it = map.cbegin(), end = map.cend(); it != end; ++it)
-        result.data()[it.key()] = Value::fromQVariant(it.value());
+        result.data()[it.key()] = fromVariant(it.value());
     return result;
 }
 
@@ -17,7 +21,7 @@ QVariantHash toVariantHash(const Object &map)
 {
     QVariantHash result;
     for (const auto &item: map.data())
-        result[item.first] = item.second.toQVariant();
+        result[toQString(item.first)] = toVariant(item.second);
     return result;
 }
 
@@ -25,7 +29,7 @@ Object fromVariantMap(const QVariantMap &map)
 {
     Object result;
     for (auto it = map.cbegin(), end = map.cend(); it != end; ++it)
-        result.data()[it.key()] = Value::fromQVariant(it.value());
+        result.data()[it.key()] = fromVariant(it.value());
     return result;
 }
 
@@ -35,7 +39,7 @@ Array fromVariantList(const QVariantList &list)
     auto &data = result.data();
     data.reserve(size_t(list.size()));
     for (const auto &item: list)
-        data.push_back(Value::fromQVariant(item));
+        data.push_back(fromVariant(item));
     return result;
 }
 
@@ -45,7 +49,7 @@ QVariantList toVariantList(const Array &list)
     const auto &data = list.data();
     result.reserve(size_t(data.size()));
     for (const auto &item: data)
-        result.push_back(item.toQVariant());
+        result.push_back(toVariant(item));
     return result;
 }
 
@@ -55,7 +59,25 @@ QVariantList toVariantList(const Array &list)
 //    explicit QbsVariantData(StdVariant v) : StdVariant(std::move(v)) {}
 //};
 
-QVariant Value::toQVariant() const
+QVariant toVariant(const DoubleArray &list)
+{
+    return QVariant::fromValue(QList<double>(list.begin(), list.end()));
+}
+
+QVariant toVariant(const Int64Array &list)
+{
+    return QVariant::fromValue(QList<qint64>(list.begin(), list.end()));
+}
+
+QVariant Value::toQVariant(RECURSIVEVARIANT_COPY_SITE_DEFINITION) const
+{
+#if defined(RECURSIVEVARIANT_TRACK_COPIES)
+    CopyTracker::record(CopyTracker::Event::ToQVariant, 0, site);
+#endif
+    return toVariant(*this);
+}
+
+QVariant toVariant(const Value &v)
 {
     auto visitor = [](auto&& value) -> QVariant {
         using T = std::decay_t<decltype(value)>;
@@ -63,13 +85,25 @@ QVariant Value::toQVariant() const
             return toVariantHash(value);
         else if constexpr (std::is_same_v<T, Array>)
             return toVariantList(value);
+        else if constexpr (std::is_same_v<T, DoubleArray> || std::is_same_v<T, Int64Array>)
+            return toVariant(value);
+        else if constexpr (std::is_same_v<T, CompactString>)
+            return value.toQString();
         else
             return QVariant::fromValue(value);
     };
-    return std::visit(visitor, static_cast<const ValueBase&>(*this));
+    return std::visit(visitor, static_cast<const ValueBase&>(v));
+}
+
+Value Value::fromQVariant(const QVariant &v RECURSIVEVARIANT_AND_COPY_SITE_DEFINITION)
+{
+#if defined(RECURSIVEVARIANT_TRACK_COPIES)
+    CopyTracker::record(CopyTracker::Event::FromQVariant, 0, site);
+#endif
+    return fromVariant(v);
 }
 
-Value Value::fromQVariant(const QVariant &v)
+Value fromVariant(const QVariant &v)
 {
     switch (v.userType()) {
     case QMetaType::Int: return v.toInt();
@@ -80,6 +114,14 @@ Value Value::fromQVariant(const QVariant &v)
     case QMetaType::QVariantMap: return fromVariantMap(v.toMap());
     case QMetaType::QVariantList: return fromVariantList(v.toList());
     default:
+        if (v.userType() == qMetaTypeId<QList<double>>()) {
+            const auto list = v.value<QList<double>>();
+            return DoubleArray(list.begin(), list.end());
+        }
+        if (v.userType() == qMetaTypeId<QList<qint64>>()) {
+            const auto list = v.value<QList<qint64>>();
+            return Int64Array(list.begin(), list.end());
+        }
         throw std::runtime_error(std::string("Unsupported variant type: ") + v.typeName());
     }
     return {};
@@ -1,6 +1,9 @@
 #pragma once
 
-#include "fastpimpl.h"
+#include "compactstring.h"
+#include "copytracker.h"
+#include "orderedhashmap.h"
+#include "typedarray.h"
 #include "utils.h"
 
 #include <QtCore/QSharedDataPointer>
@@ -11,9 +14,41 @@
 #include <unordered_map>
 #include <vector>
 #include <memory>
+#include <stdexcept>
 
 class Value;
 
+// Build with RECURSIVEVARIANT_COMPACT_KEYS defined to store Object keys as CompactString
+#if defined(RECURSIVEVARIANT_COMPACT_KEYS)
+using ObjectKey = CompactString;
+#else
+using ObjectKey = QString;
+#endif
+
+// Objects keep their keys in insertion order, unless built with
+// RECURSIVEVARIANT_UNORDERED_OBJECTS defined, which selects std::unordered_map
+#if defined(RECURSIVEVARIANT_UNORDERED_OBJECTS)
+using ObjectMap = std::unordered_map<ObjectKey, Value, StringKeyHash, StringKeyEqual>;
+#else
+using ObjectMap = OrderedHashMap<ObjectKey, Value, StringKeyHash, StringKeyEqual>;
+#endif
+
+// Per call-site lookup hint for Object, remembers the position in insertion order of the key
+// found last. Objects built the same way have their keys at the same positions, so the key at
+// that position is tried before the hashed lookup. It is only a position: plain Objects each
+// keep their own keys, sharing them is what ShapedObject is for.
+// Not thread-safe; use a thread_local or a per-thread instance when shared between threads.
+struct LookupHint
+{
+    size_t position{0};
+};
+
+// Array and Object are implicitly shared, like QString and QStringList: copying one only
+// shares its data, which is copied when a shared instance is modified. Non-const access, such
+// as data(), begin(), end() and operator[], first gives the instance data of its own, so it
+// may allocate and is not noexcept, even if nothing is written. As with Qt containers, do not
+// write through references or iterators obtained before copying the container, the copy
+// shares the data they point into.
 class Array
 {
 public:
@@ -29,15 +64,17 @@ public:
     Array &operator=(Array &&other) noexcept;
     ~Array();
 
-    Data &data() noexcept { return *d.Ptr(); }
-    const Data &data() const noexcept { return *d.Ptr(); }
+    Data &data(RECURSIVEVARIANT_COPY_SITE);
+    const Data &data() const noexcept;
+    // True if both arrays share the same data, which implies they are equal
+    bool isSharedWith(const Array &other) const noexcept { return d == other.d; }
 
-    iterator begin() noexcept;
+    iterator begin(RECURSIVEVARIANT_COPY_SITE);
     const_iterator begin() const noexcept;
     const_iterator cbegin() const noexcept;
     const_iterator constBegin() const noexcept;
 
-    iterator end() noexcept;
+    iterator end(RECURSIVEVARIANT_COPY_SITE);
     const_iterator end() const noexcept;
     const_iterator cend() const noexcept;
     const_iterator constEnd() const noexcept;
@@ -47,26 +84,33 @@ public:
     bool empty() const noexcept;
     bool isEmpty() const noexcept;
     size_t size() const noexcept;
+    void reserve(size_t size RECURSIVEVARIANT_AND_COPY_SITE);
 
-    void append(Value v);
-    void push_back(Value v);
+    void append(Value v RECURSIVEVARIANT_AND_COPY_SITE);
+    void push_back(Value v RECURSIVEVARIANT_AND_COPY_SITE);
 
-    iterator insert(iterator it, Value v);
+    iterator insert(iterator it, Value v RECURSIVEVARIANT_AND_COPY_SITE);
     template<typename It>
-    iterator insert(iterator it, It begin, It end);
+    iterator insert(iterator it, It begin, It end RECURSIVEVARIANT_AND_COPY_SITE);
 
-    Value &operator[](size_t index) noexcept;
+    Value &operator[](size_t index);
     const Value &operator[](size_t index) const noexcept;
 
 private:
-    // std::vector is 3 pointers and it's size and alignment *should not* depend on the type
-    using FakeType = std::vector<void*>;
-    FastPimpl<Data, sizeof(FakeType), alignof(FakeType)> d;
+    // null for a default-constructed or moved-from array, data() then returns an empty one
+    QSharedDataPointer<Data> d;
 };
 
 class Object
 {
+    // QString keys of a CompactString keyed object, and QStringView ones
+    template<typename K>
+    using EnableIfLookupKey = std::enable_if_t<
+            (std::is_same_v<K, QString> || std::is_same_v<K, QStringView>)
+            && !std::is_same_v<K, ObjectKey>>;
+
 public:
+    using Key = ObjectKey;
     class Data;
     class iterator;
     class const_iterator;
@@ -79,41 +123,55 @@ public:
     Object &operator=(Object &&other);
     ~Object();
 
-    Data &data() noexcept { return *d.Ptr(); }
-    const Data &data() const noexcept { return *d.Ptr(); }
+    Data &data(RECURSIVEVARIANT_COPY_SITE);
+    const Data &data() const noexcept;
+    // True if both objects share the same data, which implies they are equal
+    bool isSharedWith(const Object &other) const noexcept { return d == other.d; }
 
-    iterator begin() noexcept;
+    iterator begin(RECURSIVEVARIANT_COPY_SITE);
     const_iterator begin() const noexcept;
     const_iterator cbegin() const noexcept;
     const_iterator constBegin() const noexcept;
 
-    iterator end() noexcept;
+    iterator end(RECURSIVEVARIANT_COPY_SITE);
     const_iterator end() const noexcept;
     const_iterator cend() const noexcept;
     const_iterator constEnd() const noexcept;
 
-    const Value &at(const QString &key) const;
-    const_iterator find(const QString &key) const noexcept;
+    const Value &at(const Key &key) const;
+    const Value &at(const Key &key, LookupHint &hint) const;
+    const_iterator find(const Key &key) const noexcept;
+    const_iterator find(const Key &key, LookupHint &hint) const noexcept;
     template<typename T = Value>
-    T value(const QString &key, T defaultValue = {}) const;
+    T value(const Key &key, T defaultValue = {}) const;
+    // Lookups by text that is not a Key, without converting it to one
+    template<typename K, typename = EnableIfLookupKey<K>>
+    const Value &at(const K &key) const;
+    template<typename K, typename = EnableIfLookupKey<K>>
+    const_iterator find(const K &key) const noexcept;
+    template<typename T = Value, typename K, typename = EnableIfLookupKey<K>>
+    T value(const K &key, T defaultValue = {}) const;
+    template<typename K, typename = EnableIfLookupKey<K>>
+    bool contains(const K &key) const noexcept;
 
     bool empty() const noexcept;
     bool isEmpty() const noexcept;
     size_t size() const noexcept;
-    bool contains(const QString &key) const noexcept;
+    void reserve(size_t size RECURSIVEVARIANT_AND_COPY_SITE);
+    bool contains(const Key &key) const noexcept;
 
-    std::pair<iterator, bool> insert(std::pair<QString, Value>);
+    std::pair<iterator, bool> insert(std::pair<Key, Value> RECURSIVEVARIANT_AND_COPY_SITE);
     // template<typename It>
     // iterator insert(iterator it, It begin, It end);
-    iterator erase(iterator it);
-    iterator erase(const_iterator it);
-    size_t erase(const QString &key);
+    iterator erase(iterator it RECURSIVEVARIANT_AND_COPY_SITE);
+    iterator erase(const_iterator it RECURSIVEVARIANT_AND_COPY_SITE);
+    size_t erase(const Key &key RECURSIVEVARIANT_AND_COPY_SITE);
 
-    Value &operator[](const QString &key);
+    Value &operator[](const Key &key);
 
 private:
-    using FakeType = std::unordered_map<void *, void *>;
-    FastPimpl<Data, sizeof(FakeType), alignof(FakeType)> d;
+    // null for a default-constructed or moved-from object, data() then returns an empty one
+    QSharedDataPointer<Data> d;
 };
 
 using ValueBase = std::variant<
@@ -127,7 +185,10 @@ using ValueBase = std::variant<
     QString,
     QStringList,
     Array,
-    Object
+    Object,
+    DoubleArray,
+    Int64Array,
+    CompactString
 >;
 
 class Value: public ValueBase
@@ -144,11 +205,17 @@ public:
         String,
         StringList,
         Array,
-        Object
+        Object,
+        DoubleArray,
+        Int64Array,
+        CompactString
     };
 
     using ValueBase::ValueBase;
     Value();
+    // String literals are stored as QString, not CompactString
+    Value(const char *s) : ValueBase(QString(s)) {}
+    Value(QLatin1String s) : ValueBase(QString(s)) {}
     Value(ValueBase v) noexcept;
     ~Value();
     Value(const Value &other);
@@ -159,8 +226,14 @@ public:
 
     bool isNull() const noexcept { return index() == 0; }
     Type type() const noexcept { return Type(index()); }
+    // True if both values hold the same shared string, list or container data, which implies
+    // they are equal. Always false for scalars.
+    bool isSharedWith(const Value &other) const noexcept;
 
     void clear() { *this = {}; }
+    // Hands the value to Reclaimer::instance(), which destroys large trees on a background
+    // thread, and leaves this value null
+    void releaseAsync();
 
     template<typename T>
     const T *getIf() const noexcept { return std::get_if<T>(this); }
@@ -174,17 +247,25 @@ public:
     template<typename T>
     T value(T defaultValue = {}) const
     {
+        // both string representations convert to each other
+        if constexpr (std::is_same_v<T, QString>) {
+            if (auto compact = getIf<CompactString>())
+                return compact->toQString();
+        } else if constexpr (std::is_same_v<T, CompactString>) {
+            if (auto string = getIf<QString>())
+                return CompactString(*string);
+        }
         auto result = getIf<T>();
         if (!result)
             return std::move(defaultValue);
         return *result;
     }
 
-    QVariant toQVariant() const;
-    static Value fromQVariant(const QVariant &v);
+    QVariant toQVariant(RECURSIVEVARIANT_COPY_SITE) const;
+    static Value fromQVariant(const QVariant &v RECURSIVEVARIANT_AND_COPY_SITE);
 };
 
-class Array::Data : public std::vector<Value>
+class Array::Data : public QSharedData, public std::vector<Value>
 {
 public:
     using Base = std::vector<Value>;
@@ -280,17 +361,17 @@ private:
     Data d{};
 };
 
-class Object::Data : public std::unordered_map<QString, Value>
+class Object::Data : public QSharedData, public ObjectMap
 {
 public:
-    using Base = std::unordered_map<QString, Value>;
+    using Base = ObjectMap;
     using Base::Base;
 };
 
 class Object::const_iterator
 {
 public:
-    using Data = std::unordered_map<QString, Value>::const_iterator;
+    using Data = Object::Data::Base::const_iterator;
 
     using iterator_category = Data::iterator_category;
     using difference_type = Data::difference_type;
@@ -320,7 +401,7 @@ private:
 class Object::iterator
 {
 public:
-    using Data = std::unordered_map<QString, Value>::iterator;
+    using Data = Object::Data::Base::iterator;
 
     using iterator_category = Data::iterator_category;
     using difference_type = Data::difference_type;
@@ -351,7 +432,7 @@ private:
 
 // VariantArray implementation
 inline Array::Array() = default;
-inline Array::Array(Data data) : d(std::move(data))
+inline Array::Array(Data data) : d(new Data(std::move(data)))
 {
 }
 
@@ -361,7 +442,35 @@ inline Array &Array::operator=(const Array &other) = default;
 inline Array &Array::operator=(Array &&other) noexcept = default;
 inline Array::~Array() = default;
 
-inline auto Array::begin() noexcept -> iterator { return data().begin(); }
+inline auto Array::data(RECURSIVEVARIANT_COPY_SITE_DEFINITION) -> Data &
+{
+    const Data *shared = d.constData();
+    if (!shared) {
+        d.reset(new Data);
+        return *d;
+    }
+#if defined(RECURSIVEVARIANT_TRACK_COPIES)
+    // read before detaching, the other owners may release the data meanwhile
+    const size_t size = shared->size();
+    auto &result = *d;
+    if (&result != shared)
+        CopyTracker::record(CopyTracker::Event::ArrayCopy, size, site);
+    return result;
+#else
+    return *d;
+#endif
+}
+
+inline auto Array::data() const noexcept -> const Data &
+{
+    static const Data empty;
+    return d.constData() ? *d : empty;
+}
+
+inline auto Array::begin(RECURSIVEVARIANT_COPY_SITE_DEFINITION) -> iterator
+{
+    return data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).begin();
+}
 inline auto Array::begin() const noexcept -> const_iterator { return data().cbegin(); }
 inline auto Array::cbegin() const noexcept -> const_iterator
 {
@@ -372,7 +481,10 @@ inline auto Array::constBegin() const noexcept -> const_iterator
     return data().cbegin();
 }
 
-inline auto Array::end() noexcept -> iterator { return data().end(); }
+inline auto Array::end(RECURSIVEVARIANT_COPY_SITE_DEFINITION) -> iterator
+{
+    return data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).end();
+}
 inline auto Array::end() const noexcept -> const_iterator { return data().cend(); }
 inline auto Array::cend() const noexcept -> const_iterator { return data().cend(); }
 inline auto Array::constEnd() const noexcept -> const_iterator { return data().cend(); }
@@ -381,22 +493,38 @@ inline const Value & Array::at(size_t index) const { return data().at(index); }
 inline bool Array::empty() const noexcept { return data().empty(); }
 inline bool Array::isEmpty() const noexcept { return empty(); }
 inline size_t Array::size() const noexcept { return data().size(); }
+inline void Array::reserve(size_t size RECURSIVEVARIANT_AND_COPY_SITE_DEFINITION)
+{
+    data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).reserve(size);
+}
 
-inline void Array::append(Value v) { data().push_back(std::move(v)); }
-inline void Array::push_back(Value v) { data().push_back(std::move(v)); }
-inline auto Array::insert(iterator it, Value v) -> iterator
-{ return data().insert(it.data(), std::move(v)); }
+inline void Array::append(Value v RECURSIVEVARIANT_AND_COPY_SITE_DEFINITION)
+{
+    data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).push_back(std::move(v));
+}
+inline void Array::push_back(Value v RECURSIVEVARIANT_AND_COPY_SITE_DEFINITION)
+{
+    data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).push_back(std::move(v));
+}
+inline auto Array::insert(iterator it, Value v RECURSIVEVARIANT_AND_COPY_SITE_DEFINITION)
+        -> iterator
+{
+    return data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).insert(it.data(), std::move(v));
+}
 template<typename It>
-inline auto Array::insert(iterator it, It begin, It end) -> iterator
-{ return data().insert(it, begin, end); }
+inline auto Array::insert(iterator it, It begin, It end RECURSIVEVARIANT_AND_COPY_SITE_DEFINITION)
+        -> iterator
+{
+    return data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).insert(it, begin, end);
+}
 
-inline Value &Array::operator[](size_t index) noexcept { return data()[index]; }
+inline Value &Array::operator[](size_t index) { return data()[index]; }
 inline const Value &Array::operator[](size_t index) const noexcept
 { return data()[index]; }
 
 // VariantObject implementation
 inline Object::Object() = default;
-inline Object::Object(Data data) : d(std::move(data))
+inline Object::Object(Data data) : d(new Data(std::move(data)))
 {}
 inline Object::Object(const Object &other) = default;
 inline Object::Object(Object &&other) = default;
@@ -404,7 +532,35 @@ inline Object &Object::operator=(const Object &other) = default;
 inline Object &Object::operator=(Object &&other) = default;
 inline Object::~Object() = default;
 
-inline auto Object::begin() noexcept -> iterator { return data().begin(); }
+inline auto Object::data(RECURSIVEVARIANT_COPY_SITE_DEFINITION) -> Data &
+{
+    const Data *shared = d.constData();
+    if (!shared) {
+        d.reset(new Data);
+        return *d;
+    }
+#if defined(RECURSIVEVARIANT_TRACK_COPIES)
+    // read before detaching, the other owners may release the data meanwhile
+    const size_t size = shared->size();
+    auto &result = *d;
+    if (&result != shared)
+        CopyTracker::record(CopyTracker::Event::ObjectCopy, size, site);
+    return result;
+#else
+    return *d;
+#endif
+}
+
+inline auto Object::data() const noexcept -> const Data &
+{
+    static const Data empty;
+    return d.constData() ? *d : empty;
+}
+
+inline auto Object::begin(RECURSIVEVARIANT_COPY_SITE_DEFINITION) -> iterator
+{
+    return data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).begin();
+}
 inline auto Object::begin() const noexcept -> const_iterator { return data().cbegin(); }
 inline auto Object::cbegin() const noexcept -> const_iterator
 {
@@ -415,37 +571,106 @@ inline auto Object::constBegin() const noexcept -> const_iterator
     return data().cbegin();
 }
 
-inline auto Object::end() noexcept -> iterator { return data().end(); }
+inline auto Object::end(RECURSIVEVARIANT_COPY_SITE_DEFINITION) -> iterator
+{
+    return data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).end();
+}
 inline auto Object::end() const noexcept -> const_iterator { return data().cend(); }
 inline auto Object::cend() const noexcept -> const_iterator { return data().cend(); }
 inline auto Object::constEnd() const noexcept -> const_iterator { return data().cend(); }
 
-inline const Value &Object::at(const QString &key) const { return data().at(key); }
-inline auto Object::find(const QString &key) const noexcept -> const_iterator
+inline const Value &Object::at(const Key &key) const { return data().at(key); }
+inline const Value &Object::at(const Key &key, LookupHint &hint) const
+{
+    const auto it = find(key, hint);
+    if (it == cend())
+        throw std::out_of_range("Object::at: no such key");
+    return it->second;
+}
+inline auto Object::find(const Key &key) const noexcept -> const_iterator
 {
     return data().find(key);
 }
+inline auto Object::find(const Key &key, LookupHint &hint) const noexcept -> const_iterator
+{
+#if defined(RECURSIVEVARIANT_UNORDERED_OBJECTS)
+    Q_UNUSED(hint);
+    return data().find(key);
+#else
+    return data().find(key, hint.position);
+#endif
+}
 template<typename T>
-inline T Object::value(const QString &key, T defaultValue) const
+inline T Object::value(const Key &key, T defaultValue) const
+{
+    const auto it = find(key);
+    if (it == cend())
+        return defaultValue;
+    if constexpr (std::is_same_v<T, Value>)
+        return it->second;
+    else
+        return it->second.value<T>(std::move(defaultValue));
+}
+template<typename K, typename>
+inline const Value &Object::at(const K &key) const
+{
+    const auto it = find(key);
+    if (it == cend())
+        throw std::out_of_range("Object::at: no such key");
+    return it->second;
+}
+template<typename K, typename>
+inline auto Object::find(const K &key) const noexcept -> const_iterator
+{
+#if defined(RECURSIVEVARIANT_UNORDERED_OBJECTS)
+    // std::unordered_map has no heterogeneous lookup before C++20
+    return data().find(Key(QStringView(key).toString()));
+#else
+    return data().find(key);
+#endif
+}
+template<typename T, typename K, typename>
+inline T Object::value(const K &key, T defaultValue) const
 {
     const auto it = find(key);
-    return it == cend() ? defaultValue : it->second;
+    if (it == cend())
+        return defaultValue;
+    if constexpr (std::is_same_v<T, Value>)
+        return it->second;
+    else
+        return it->second.template value<T>(std::move(defaultValue));
 }
+template<typename K, typename>
+inline bool Object::contains(const K &key) const noexcept { return find(key) != cend(); }
 inline bool Object::empty() const noexcept { return data().empty(); }
 inline bool Object::isEmpty() const noexcept { return empty(); }
 inline size_t Object::size() const noexcept { return data().size(); }
-inline bool Object::contains(const QString &key) const noexcept { return data().count(key) > 0; }
+inline void Object::reserve(size_t size RECURSIVEVARIANT_AND_COPY_SITE_DEFINITION)
+{
+    data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).reserve(size);
+}
+inline bool Object::contains(const Key &key) const noexcept { return data().count(key) > 0; }
 
-inline auto Object::insert(std::pair<QString, Value> value) -> std::pair<iterator, bool>
+inline auto Object::insert(std::pair<Key, Value> value RECURSIVEVARIANT_AND_COPY_SITE_DEFINITION)
+        -> std::pair<iterator, bool>
 {
-    return data().insert(std::move(value));
+    return data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).insert(std::move(value));
 }
 
-inline auto Object::erase(iterator it) -> iterator { return data().erase(it.data()); }
-inline auto Object::erase(const_iterator it) -> iterator { return data().erase(it.data()); }
-inline auto Object::erase(const QString &key) -> size_t { return data().erase(key); }
+inline auto Object::erase(iterator it RECURSIVEVARIANT_AND_COPY_SITE_DEFINITION) -> iterator
+{
+    return data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).erase(it.data());
+}
+inline auto Object::erase(const_iterator it RECURSIVEVARIANT_AND_COPY_SITE_DEFINITION) -> iterator
+{
+    return data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).erase(it.data());
+}
+inline auto Object::erase(const Key &key RECURSIVEVARIANT_AND_COPY_SITE_DEFINITION) -> size_t
+{
+    return data(RECURSIVEVARIANT_COPY_SITE_ARGUMENT).erase(key);
+}
 
-inline Value &Object::operator[](const QString &key) { return data()[key]; }
+inline Value &Object::operator[](const Key &key) { return data()[key]; }
 
 inline Value::Value() = default;
 inline Value::Value(ValueBase v) noexcept : ValueBase(std::move(v)) {}
@@ -455,60 +680,149 @@ inline Value &Value::operator=(const Value &other) = default;
 inline Value &Value::operator=(Value &&other) = default;
 inline Value::~Value() = default;
 
+inline bool Value::isSharedWith(const Value &other) const noexcept
+{
+    if (index() != other.index())
+        return false;
+    switch (type()) {
+    case Type::String: {
+        const auto &lhs = *getIf<QString>();
+        const auto &rhs = *other.getIf<QString>();
+        return lhs.constData() == rhs.constData() && lhs.size() == rhs.size();
+    }
+    case Type::StringList: {
+        const auto &lhs = *getIf<QStringList>();
+        const auto &rhs = *other.getIf<QStringList>();
+        return lhs.constData() == rhs.constData() && lhs.size() == rhs.size();
+    }
+    case Type::Array:
+        return getIf<Array>()->isSharedWith(*other.getIf<Array>());
+    case Type::Object:
+        return getIf<Object>()->isSharedWith(*other.getIf<Object>());
+    default:
+        return false;
+    }
+}
+
+template<typename T>
+inline TypedArray<T> TypedArray<T>::fromArray(const Array &array)
+{
+    TypedArray<T> result;
+    result.reserve(array.size());
+    for (const auto &item: array) {
+        auto visitor = [](auto&& value) -> T {
+            using U = std::decay_t<decltype(value)>;
+            if constexpr (std::is_arithmetic_v<U> && !std::is_same_v<U, bool>) {
+                if (const auto result = exactCast<T>(value))
+                    return *result;
+                throw std::range_error("Array contains a number the array cannot represent");
+            } else {
+                throw std::runtime_error("Array contains a non-numeric value");
+            }
+        };
+        result.append(std::visit(visitor, static_cast<const ValueBase &>(item)));
+    }
+    return result;
+}
+
+template<typename T>
+inline Array TypedArray<T>::toArray() const
+{
+    Array result;
+    auto &data = result.data();
+    data.reserve(size());
+    for (const auto &item: d)
+        data.emplace_back(item);
+    return result;
+}
+
 inline bool operator==(const Array &lhs, const Array &rhs)
 {
-    return lhs.data() == rhs.data();
+    return lhs.isSharedWith(rhs) || lhs.data() == rhs.data();
 }
 
 inline bool operator!=(const Array &lhs, const Array &rhs)
 {
-    return lhs.data() != rhs.data();
+    return !(lhs == rhs);
 }
 
 inline bool operator==(const Object &lhs, const Object &rhs)
 {
-    return lhs.data() == rhs.data();
+    return lhs.isSharedWith(rhs) || lhs.data() == rhs.data();
 }
 
 inline bool operator!=(const Object &lhs, const Object &rhs)
 {
-    return lhs.data() != rhs.data();
+    return !(lhs == rhs);
 }
 
 inline bool operator==(const Value &lhs, const Value &rhs)
 {
-    return static_cast<const ValueBase &>(lhs) == static_cast<const ValueBase &>(rhs);
+    if (lhs.index() != rhs.index()) {
+        // QString and CompactString with the same text are equal
+        if (const auto compact = lhs.getIf<CompactString>()) {
+            const auto string = rhs.getIf<QString>();
+            return string && compact->equals(*string);
+        }
+        if (const auto compact = rhs.getIf<CompactString>()) {
+            const auto string = lhs.getIf<QString>();
+            return string && compact->equals(*string);
+        }
+        return false;
+    }
+    return lhs.isSharedWith(rhs)
+            || static_cast<const ValueBase &>(lhs) == static_cast<const ValueBase &>(rhs);
 }
 
 inline bool operator!=(const Value &lhs, const Value &rhs)
 {
-    return static_cast<const ValueBase &>(lhs) != static_cast<const ValueBase &>(rhs);
+    return !(lhs == rhs);
 }
 
 namespace std {
 
 template<> struct hash<Object>
 {
-    std::size_t operator()(const Object &s) const noexcept
-    {
-        return hashRange(s.data());
-    }
+    std::size_t operator()(const Object &s) const noexcept;
 };
 
 template<> struct hash<Array>
 {
-    std::size_t operator()(const Array &s) const noexcept
-    {
-        return hashRange(s.data());
-    }
+    std::size_t operator()(const Array &s) const noexcept;
 };
 
 template<> struct hash<Value>
 {
-    std::size_t operator()(const Value &s) const noexcept
-    {
-        return std::hash<ValueBase>()(s);
-    }
+    std::size_t operator()(const Value &s) const noexcept;
 };
 
+inline std::size_t hash<Object>::operator()(const Object &s) const noexcept
+{
+    // equal objects may hold their entries in a different order
+    return hashUnordered(s.data(), [](const auto &item) {
+        return Hashing::combine(StringKeyHash()(item.first), std::hash<Value>()(item.second));
+    });
+}
+
+inline std::size_t hash<Array>::operator()(const Array &s) const noexcept
+{
+    return hashRange(s.data());
+}
+
+inline std::size_t hash<Value>::operator()(const Value &s) const noexcept
+{
+    auto visitor = [](const auto &value) -> size_t {
+        using T = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<T, QString> || std::is_same_v<T, CompactString>)
+            return StringKeyHash()(value);
+        else
+            return std::hash<T>()(value);
+    };
+    const size_t valueHash = std::visit(visitor, static_cast<const ValueBase &>(s));
+    // CompactString hashes as QString, as they compare equal
+    const auto index = s.type() == Value::Type::CompactString ? size_t(Value::Type::String)
+                                                              : s.index();
+    return Hashing::finalize(Hashing::combine(Hashing::seed(), valueHash), index);
+}
+
 } // namespace std